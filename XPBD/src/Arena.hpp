@@ -0,0 +1,100 @@
+// ----------------------------------------------------------------------------
+// Arena.hpp
+//
+// Description: Monotonic arena for the per-simulation objects of PbdSolver,
+//              released all at once and reused by the next simulation
+// ----------------------------------------------------------------------------
+
+#ifndef _ARENA_HPP_
+#define _ARENA_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Objects are placed one after the other in large blocks and never freed one
+// by one; reset() drops them all, which is why only trivially destructible
+// types are accepted. The memory is kept: after a reset the blocks are merged
+// into one, so a simulation of the same size allocates nothing.
+class Arena {
+public:
+  Arena() : _block(0), _used(0) {}
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&) = default;    // the blocks, and the objects in them, do not move
+  Arena &operator=(Arena &&) = default;
+
+  std::size_t capacity() const
+  {
+    std::size_t total = 0;
+    for(std::size_t s : _sizes) total += s;
+    return total;
+  }
+
+  // Makes sure that the next `bytes` fit without a new block
+  void reserve(const std::size_t bytes)
+  {
+    if(_block < _blocks.size() && _used + bytes <= _sizes[_block])
+      return;
+    if(_block + 1 < _blocks.size() && bytes <= _sizes[_block + 1]) {
+      ++_block;
+      _used = 0;
+      return;
+    }
+    addBlock(bytes);
+  }
+
+  void *allocate(const std::size_t bytes, const std::size_t align)
+  {
+    std::size_t offset = (_used + align - 1) / align * align;
+    if(_block >= _blocks.size() || offset + bytes > _sizes[_block]) {
+      reserve(bytes + align);
+      offset = (_used + align - 1) / align * align;
+    }
+    _used = offset + bytes;
+    return _blocks[_block].get() + offset;
+  }
+
+  template<typename T, typename... Args>
+  T *create(Args &&... args)
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  void reset()
+  {
+    if(_blocks.size() > 1) {
+      const std::size_t total = capacity();
+      _blocks.clear();
+      _sizes.clear();
+      _blocks.emplace_back(new char[total]);
+      _sizes.push_back(total);
+    }
+    _block = 0;
+    _used = 0;
+  }
+
+private:
+  // Inserted after the current block, twice as large as the last one at least
+  void addBlock(const std::size_t bytes)
+  {
+    const std::size_t size = std::max(bytes, _sizes.empty() ? std::size_t(4096) : 2*_sizes.back());
+    const std::size_t at = _blocks.empty() ? 0 : _block + 1;
+    _blocks.emplace(_blocks.begin() + at, new char[size]);
+    _sizes.insert(_sizes.begin() + at, size);
+    _block = at;
+    _used = 0;
+  }
+
+  std::vector<std::unique_ptr<char[]>> _blocks;
+  std::vector<std::size_t> _sizes;
+  std::size_t _block;           // block being filled
+  std::size_t _used;            // bytes used in it
+};
+
+#endif  /* _ARENA_HPP_ */
@@ -0,0 +1,211 @@
+#include "BinaryCache.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#include <direct.h>
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kCacheMagic[8] = {'X', 'P', 'B', 'D', 'C', 'A', 'C', 'H'};
+const std::uint32_t kCacheVersion = 1;
+const std::uint32_t kByteOrderMark = 0x01020304;
+
+struct CacheHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t key;
+  std::uint64_t numSections;
+};
+
+struct CacheSection {
+  std::uint32_t tag;
+  std::uint32_t stride;
+  std::uint64_t count;
+  std::uint64_t offset;         // from the beginning of the file
+};
+
+std::uint64_t alignUp(const std::uint64_t x)
+{
+  return (x + kCacheAlignment - 1) / kCacheAlignment * kCacheAlignment;
+}
+
+inline std::uint64_t mix(std::uint64_t h, const std::uint64_t v)
+{
+  h ^= v * 0x9e3779b97f4a7c15ull;
+  h = (h << 31) | (h >> 33);
+  return h * 0xbf58476d1ce4e5b9ull;
+}
+
+// Temporary name of a file being written, unique to the writer, so that
+// concurrent writers of the same file never write to the same one
+std::string temporaryName(const std::string &filename)
+{
+  static std::atomic<unsigned int> counter(0);
+  return filename + "." + std::to_string(getpid()) + "." + std::to_string(counter++) + ".tmp";
+}
+
+// Replaces filename by tmp at once; readers see either file, whole
+bool replaceFile(const std::string &tmp, const std::string &filename)
+{
+#ifdef _WIN32
+  return MoveFileExA(tmp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return std::rename(tmp.c_str(), filename.c_str()) == 0;
+#endif
+}
+
+} // namespace
+
+std::uint64_t hashBytes(const void *data, const std::size_t size, const std::uint64_t seed)
+{
+  const char *p = static_cast<const char *>(data);
+  std::uint64_t h[4] = {seed ^ 0x243f6a8885a308d3ull, seed ^ 0x13198a2e03707344ull,
+                        seed ^ 0xa4093822299f31d0ull, seed ^ 0x082efa98ec4e6c89ull};
+  std::size_t i = 0;
+  for(; i + 32 <= size; i += 32) {
+    std::uint64_t w[4];
+    std::memcpy(w, p + i, 32);
+    for(int l = 0; l < 4; ++l)
+      h[l] = mix(h[l], w[l]);
+  }
+  std::uint64_t tail[4] = {0, 0, 0, 0};
+  std::memcpy(tail, p + i, size - i);
+  for(int l = 0; l < 4; ++l)
+    h[l] = mix(h[l], tail[l]);
+
+  std::uint64_t r = mix(mix(mix(mix(size, h[0]), h[1]), h[2]), h[3]);
+  r ^= r >> 29;
+  r *= 0x94d049bb133111ebull;
+  return r ^ (r >> 32);
+}
+
+void CacheWriter::add(const std::uint32_t tag, const void *data, const std::uint32_t stride, const std::uint64_t count)
+{
+  Section s = {tag, stride, count, data};
+  _sections.push_back(s);
+}
+
+bool CacheWriter::write(const std::string &filename, const std::uint64_t key) const
+{
+  CacheHeader header;
+  std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.byteOrder = kByteOrderMark;
+  header.key = key;
+  header.numSections = _sections.size();
+
+  std::vector<CacheSection> table(_sections.size());
+  std::uint64_t offset = alignUp(sizeof(CacheHeader) + table.size()*sizeof(CacheSection));
+  for(std::size_t k = 0; k < _sections.size(); ++k) {
+    const CacheSection s = {_sections[k].tag, _sections[k].stride, _sections[k].count, offset};
+    table[k] = s;
+    offset = alignUp(offset + s.stride*s.count);
+  }
+
+  const std::string tmp = temporaryName(filename);
+  {
+    std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out)
+      return false;
+    const char pad[kCacheAlignment] = {};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(table.data()), table.size()*sizeof(CacheSection));
+    std::uint64_t at = sizeof(header) + table.size()*sizeof(CacheSection);
+    for(std::size_t k = 0; k < _sections.size(); ++k) {
+      out.write(pad, table[k].offset - at);
+      const std::uint64_t bytes = table[k].stride*table[k].count;
+      out.write(static_cast<const char *>(_sections[k].data), bytes);
+      at = table[k].offset + bytes;
+    }
+    out.write(pad, offset - at);
+    if(!out) {
+      out.close();
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+  if(!replaceFile(tmp, filename)) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+CacheReader::CacheReader() {}
+
+CacheReader::~CacheReader() {}
+
+bool CacheReader::open(const std::string &filename, const std::uint64_t key)
+{
+  _entries.clear();
+  _file.reset();
+  std::unique_ptr<MappedFile> file;
+  try {
+    file.reset(new MappedFile(filename));
+  } catch(const std::ios_base::failure &) {
+    return false;
+  }
+
+  CacheHeader header;
+  if(file->size() < sizeof(header))
+    return false;
+  std::memcpy(&header, file->begin(), sizeof(header));
+  if(std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header.version != kCacheVersion ||
+     header.byteOrder != kByteOrderMark || header.key != key ||
+     header.numSections > (file->size() - sizeof(header)) / sizeof(CacheSection))
+    return false;
+
+  std::vector<CacheSection> table(header.numSections);
+  std::memcpy(static_cast<void *>(table.data()), file->begin() + sizeof(header), table.size()*sizeof(CacheSection));
+  for(const CacheSection &s : table) {
+    if(s.offset % kCacheAlignment != 0 || s.offset > file->size() ||
+       (s.stride && s.count > (file->size() - s.offset) / s.stride))
+      return false;
+    const Entry e = {s.tag, s.stride, s.count, file->begin() + s.offset};
+    _entries.push_back(e);
+  }
+  _file.swap(file);
+  return true;
+}
+
+const CacheReader::Entry *CacheReader::find(const std::uint32_t tag) const
+{
+  for(const Entry &e : _entries)
+    if(e.tag == tag)
+      return &e;
+  return nullptr;
+}
+
+bool makeDirectories(const std::string &path)
+{
+  for(std::size_t at = path.find_first_of("/\\", 1); ; at = path.find_first_of("/\\", at + 1)) {
+    const std::string prefix = path.substr(0, at);
+#ifdef _WIN32
+    _mkdir(prefix.c_str());     // fails for an existing directory, or a drive
+#else
+    mkdir(prefix.c_str(), 0777);
+#endif
+    if(at == std::string::npos)
+      break;
+  }
+#ifdef _WIN32
+  const DWORD attributes = GetFileAttributesA(path.c_str());
+  return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
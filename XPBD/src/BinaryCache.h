@@ -0,0 +1,91 @@
+#ifndef BINARY_CACHE_H
+#define BINARY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Content hash of a byte range, 64-bit words in four independent lanes so
+// that hashing a large source file costs about as much as reading it
+std::uint64_t hashBytes(const void *data, std::size_t size, std::uint64_t seed=0);
+
+// Cache files hold arrays of plain values in tagged sections, each aligned
+// to kCacheAlignment in the file, after a header with a key. A reader only
+// accepts a file of the same format version, byte order and key, so a stale
+// or foreign file reads as a miss. Files are written under a temporary name
+// unique to the writer and renamed over the target, so concurrent readers
+// and writers never see a partial or mixed file.
+const std::size_t kCacheAlignment = 64;
+
+class CacheWriter {
+public:
+  template<typename T>
+  void add(const std::uint32_t tag, const std::vector<T> &a)
+  {
+    add(tag, a.data(), sizeof(T), a.size());
+  }
+  void add(const std::uint32_t tag, const void *data, const std::uint32_t stride, const std::uint64_t count);
+
+  // False if the file could not be written, e.g. in a read-only directory
+  bool write(const std::string &filename, const std::uint64_t key) const;
+
+private:
+  struct Section {
+    std::uint32_t tag, stride;
+    std::uint64_t count;
+    const void *data;
+  };
+  std::vector<Section> _sections;
+};
+
+class CacheReader {
+public:
+  CacheReader();
+  ~CacheReader();
+
+  // False if the file is missing, malformed or of another key
+  bool open(const std::string &filename, const std::uint64_t key);
+
+  bool has(const std::uint32_t tag) const { return find(tag) != nullptr; }
+
+  // Copies section tag into a; false if it is missing or of another type
+  template<typename T>
+  bool read(const std::uint32_t tag, std::vector<T> &a) const
+  {
+    const Entry *e = find(tag);
+    if(!e || e->stride != sizeof(T))
+      return false;
+    a.resize(e->count);
+    if(e->count)
+      std::memcpy(static_cast<void *>(a.data()), e->data, e->count*sizeof(T));
+    return true;
+  }
+
+private:
+  struct Entry {
+    std::uint32_t tag, stride;
+    std::uint64_t count;
+    const char *data;
+  };
+  const Entry *find(const std::uint32_t tag) const;
+
+  std::unique_ptr<MappedFile> _file;
+  std::vector<Entry> _entries;
+};
+
+// Four-character section tag
+inline std::uint32_t cacheTag(const char (&s)[5])
+{
+  return std::uint32_t(s[0]) | std::uint32_t(s[1]) << 8 | std::uint32_t(s[2]) << 16 | std::uint32_t(s[3]) << 24;
+}
+
+// Creates the directory and its missing parents; false if it does not exist
+// afterwards
+bool makeDirectories(const std::string &path);
+
+#endif  // BINARY_CACHE_H
@@ -0,0 +1,76 @@
+// ----------------------------------------------------------------------------
+// Coloring.hpp
+//
+// Description: Graph colouring of constraints for parallel Gauss-Seidel sweeps
+// ----------------------------------------------------------------------------
+
+#ifndef _COLORING_HPP_
+#define _COLORING_HPP_
+
+#include <vector>
+#include <algorithm>
+
+#include "typedefs.hpp"
+
+// Colour elements given in CSR form (element e touches the vertices
+// indices[offsets[e]] .. indices[offsets[e+1]-1]) so that two elements of the
+// same colour never share a vertex. Every pass takes a maximal independent set
+// of the remaining elements, hence colours are dense and the first ones are the
+// largest. Returns the number of colours; color[e] receives the colour of e.
+inline tUint colorElements(
+  const std::vector<tUint> &offsets, const std::vector<tUint> &indices,
+  const tUint num_vertices, std::vector<tUint> &color)
+{
+  const tUint num_elements = offsets.empty() ? 0 : offsets.size() - 1;
+  const tUint unset = static_cast<tUint>(-1);
+  color.assign(num_elements, unset);
+
+  std::vector<tUint> stamp(num_vertices, unset); // last colour that touched the vertex
+  tUint num_colors = 0, remaining = num_elements;
+  while(remaining > 0) {
+    for(tUint e = 0; e < num_elements; ++e) {
+      if(color[e] != unset) continue;
+      bool free = true;
+      for(tUint k = offsets[e]; k < offsets[e+1] && free; ++k)
+        free = (stamp[indices[k]] != num_colors);
+      if(!free) continue;
+      for(tUint k = offsets[e]; k < offsets[e+1]; ++k)
+        stamp[indices[k]] = num_colors;
+      color[e] = num_colors;
+      --remaining;
+    }
+    ++num_colors;
+  }
+  return num_colors;
+}
+
+// Same for elements that all touch exactly `arity` vertices stored contiguously.
+inline tUint colorElements(
+  const std::vector<tUint> &indices, const tUint arity,
+  const tUint num_vertices, std::vector<tUint> &color)
+{
+  std::vector<tUint> offsets(indices.size()/arity + 1);
+  for(tUint e = 0; e < offsets.size(); ++e)
+    offsets[e] = e*arity;
+  return colorElements(offsets, indices, num_vertices, color);
+}
+
+// Stable permutation that sorts elements by colour: element perm[k] goes to
+// slot k. color_offsets[c] .. color_offsets[c+1] is the range of colour c.
+inline void sortByColor(
+  const std::vector<tUint> &color, const tUint num_colors,
+  std::vector<tUint> &perm, std::vector<tUint> &color_offsets)
+{
+  color_offsets.assign(num_colors + 1, 0);
+  for(tUint c : color)
+    ++color_offsets[c+1];
+  for(tUint c = 0; c < num_colors; ++c)
+    color_offsets[c+1] += color_offsets[c];
+
+  perm.resize(color.size());
+  std::vector<tUint> head(color_offsets.begin(), color_offsets.end() - 1);
+  for(tUint e = 0; e < color.size(); ++e)
+    perm[head[color[e]]++] = e;
+}
+
+#endif  /* _COLORING_HPP_ */
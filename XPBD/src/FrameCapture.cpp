@@ -0,0 +1,333 @@
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+const FrameCapture::Image FrameCapture::kFrameImage = {FrameCapture::Encoding::kTga, GL_BGR, GL_UNSIGNED_BYTE, 3, 3};
+
+FrameCapture::FrameCapture(unsigned int numWriters)
+{
+  for(unsigned int k = 0; k < std::max(1u, numWriters); ++k)
+    _writers.push_back(std::thread(&FrameCapture::work, this));
+}
+
+FrameCapture::~FrameCapture()
+{
+  stop();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _quit = true;
+  }
+  _queued.notify_all();
+  for(std::thread &writer : _writers)
+    writer.join();
+  for(Slot &slot : _slots)
+    if(slot.pbo)
+      glDeleteBuffers(1, &slot.pbo);
+}
+
+void FrameCapture::startFiles(const std::string &prefix)
+{
+  stop();
+  _prefix = prefix;
+  _frameCount = 0;
+  _recording = true;
+}
+
+bool FrameCapture::startPipe(const std::string &command, int width, int height)
+{
+  stop();
+  std::string line = command;
+  const std::string size = std::to_string(width) + "x" + std::to_string(height);
+  for(std::size_t at = line.find("{size}"); at != std::string::npos; at = line.find("{size}", at))
+    line.replace(at, 6, size);
+#ifdef _WIN32
+  _pipe = popen(line.c_str(), "wb");
+#else
+  _sigpipeHandler = std::signal(SIGPIPE, SIG_IGN); // an encoder that quits fails the writes instead of killing us
+  _sigpipeIgnored = _sigpipeHandler != SIG_ERR;
+  _pipe = popen(line.c_str(), "w");
+#endif
+  if(!_pipe) {
+    std::cerr << "[Frame Capture][startPipe] Error: cannot run " << line << std::endl;
+    closePipe();
+    return false;
+  }
+  _pipeWidth = width;
+  _pipeHeight = height;
+  _pipeQueued = _pipeWritten = 0;
+  _pipeFailed = false;
+  _recording = true;
+  return true;
+}
+
+void FrameCapture::stop()
+{
+  _recording = false;
+  retireAll();
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _written.wait(lock, [this] { return _inFlight == 0; });
+  }
+  closePipe();
+}
+
+void FrameCapture::update(int width, int height)
+{
+  // in the order of the reads: the fences signal in that order
+  for(int k = 0; k < kCaptureBuffers; ++k) {
+    Slot &slot = _slots[(_next + k) % kCaptureBuffers];
+    if(slot.fence && !retire(slot, false))
+      break;
+  }
+  if(_pipe && pipeFailed())
+    stop();
+  if(!_recording)
+    return;
+  if(!_pipe) {
+    char number[16];
+    std::snprintf(number, sizeof(number), "%05u", _frameCount++);
+    read(_prefix + number + ".tga", kFrameImage, width, height);
+  } else if(width != _pipeWidth || height != _pipeHeight) {
+    std::cerr << "[Frame Capture][update] The window was resized: recording stopped" << std::endl;
+    stop();
+  } else {
+    Image image = kFrameImage;
+    image.encoding = Encoding::kPipe;
+    read(std::string(), image, width, height);
+  }
+}
+
+void FrameCapture::captureOnce(const std::string &filename, int width, int height)
+{
+  read(filename, kFrameImage, width, height);
+}
+
+bool FrameCapture::dumpAttachment(const std::string &filename, GLuint fbo, GLenum attachment, int width, int height)
+{
+  const std::size_t dot = filename.rfind('.');
+  const std::string extension = dot == std::string::npos ? std::string() : filename.substr(dot);
+  const bool depth = attachment == GL_DEPTH_ATTACHMENT;
+  Image image;
+  if(depth && extension == ".pgm")
+    image = {Encoding::kPgm16, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, 1, 2};
+  else if(depth && extension == ".pfm")
+    image = {Encoding::kPfm, GL_DEPTH_COMPONENT, GL_FLOAT, 1, 4};
+  else if(!depth && extension == ".tga")
+    image = kFrameImage;
+  else if(!depth && extension == ".pfm")
+    image = {Encoding::kPfm, GL_RGB, GL_FLOAT, 3, 12};
+  else {
+    std::cerr << "[Frame Capture][dumpAttachment] Error: cannot write this attachment to " << filename << std::endl;
+    return false;
+  }
+
+  GLint readFbo, readBuffer;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFbo);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glGetIntegerv(GL_READ_BUFFER, &readBuffer);
+  if(!depth)
+    glReadBuffer(attachment);   // the depth is read whatever the read buffer
+  read(filename, image, width, height);
+  if(!depth)
+    glReadBuffer(readBuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+  return true;
+}
+
+void FrameCapture::read(const std::string &filename, const Image &image, int width, int height)
+{
+  Slot &slot = _slots[_next];
+  _next = (_next + 1) % kCaptureBuffers;
+  if(slot.fence)                // the oldest read, kCaptureBuffers frames ago
+    retire(slot, true);
+
+  const GLsizeiptr size = GLsizeiptr(image.bytesPerPixel)*width*height;
+  if(!slot.pbo)
+    glGenBuffers(1, &slot.pbo);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  if(size != slot.size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    slot.size = size;
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 1); // rows of bytesPerPixel*width bytes
+  glReadPixels(0, 0, width, height, image.format, image.type, 0); // returns at once, into the buffer
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = width;
+  slot.height = height;
+  slot.image = image;
+  slot.filename = filename;
+}
+
+bool FrameCapture::retire(Slot &slot, bool wait)
+{
+  const GLuint64 timeout = wait ? 1000000000 : 0; // ns
+  GLenum status;
+  do {
+    status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+  } while(wait && status == GL_TIMEOUT_EXPIRED);
+  if(status == GL_TIMEOUT_EXPIRED)
+    return false;
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+
+  Frame frame;
+  frame.width = slot.width;
+  frame.height = slot.height;
+  frame.image = slot.image;
+  frame.filename = slot.filename;
+  frame.pixels.resize(slot.size);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+  if(pixels)
+    std::memcpy(frame.pixels.data(), pixels, slot.size);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if(!pixels)
+    return true;
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _written.wait(lock, [this] { return _queue.size() < kMaxQueuedFrames; });
+    frame.sequence = frame.image.encoding == Encoding::kPipe ? _pipeQueued++ : 0;
+    _queue.push_back(std::move(frame));
+    ++_inFlight;
+  }
+  _queued.notify_one();
+  return true;
+}
+
+void FrameCapture::retireAll()
+{
+  for(int k = 0; k < kCaptureBuffers; ++k) {
+    Slot &slot = _slots[(_next + k) % kCaptureBuffers];
+    if(slot.fence)
+      retire(slot, true);
+  }
+}
+
+void FrameCapture::work()
+{
+  for(;;) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _queued.wait(lock, [this] { return _quit || !_queue.empty(); });
+      if(_queue.empty())
+        return;
+      frame = std::move(_queue.front());
+      _queue.pop_front();
+    }
+    _written.notify_all();      // room in the queue
+
+    bool written = true;
+    if(frame.image.encoding == Encoding::kPipe) {
+      // the frames of the pipe in order, whichever writer took them
+      std::unique_lock<std::mutex> lock(_mutex);
+      _pipeTurn.wait(lock, [&] { return _pipeWritten == frame.sequence; });
+      const bool failed = _pipeFailed; // the frames after a failed one are dropped
+      lock.unlock();
+      const bool ok = failed || std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), _pipe) == frame.pixels.size();
+      if(!ok)
+        std::cerr << "[Frame Capture][work] Error: the encoder did not take frame " << frame.sequence
+                  << ": recording stopped" << std::endl;
+      lock.lock();
+      _pipeFailed = !ok || failed;
+      ++_pipeWritten;
+      _pipeTurn.notify_all();
+    } else if(frame.image.encoding == Encoding::kTga) {
+      written = saveTga(frame.filename, frame.pixels.data(), frame.width, frame.height);
+    } else if(frame.image.encoding == Encoding::kPgm16) {
+      written = savePgm16(frame.filename, reinterpret_cast<const std::uint16_t *>(frame.pixels.data()), frame.width, frame.height);
+    } else {
+      written = savePfm(frame.filename, reinterpret_cast<const float *>(frame.pixels.data()), frame.image.channels, frame.width, frame.height);
+    }
+    if(!written)
+      std::cerr << "[Frame Capture][work] Error: cannot write " << frame.filename << std::endl;
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_inFlight;
+    }
+    _written.notify_all();
+  }
+}
+
+bool FrameCapture::pipeFailed()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pipeFailed;
+}
+
+void FrameCapture::closePipe()
+{
+  if(_pipe) {
+    pclose(_pipe);
+    _pipe = nullptr;
+  }
+#ifndef _WIN32
+  if(_sigpipeIgnored) {
+    std::signal(SIGPIPE, _sigpipeHandler);
+    _sigpipeIgnored = false;
+  }
+#endif
+}
+
+bool saveTga(const std::string &filename, const std::uint8_t *bgr, int width, int height)
+{
+  std::FILE *out = std::fopen(filename.c_str(), "wb");
+  if(!out)
+    return false;
+  std::uint8_t header[18] = {};
+  header[2] = 2;                // uncompressed true-color
+  header[12] = width & 0xff;
+  header[13] = (width >> 8) & 0xff;
+  header[14] = height & 0xff;
+  header[15] = (height >> 8) & 0xff;
+  header[16] = 24;              // bits per pixel; origin at the bottom left
+  const std::size_t bytes = std::size_t(3)*width*height;
+  const bool ok = std::fwrite(header, 1, sizeof(header), out) == sizeof(header) &&
+    std::fwrite(bgr, 1, bytes, out) == bytes;
+  return std::fclose(out) == 0 && ok;
+}
+
+bool savePgm16(const std::string &filename, const std::uint16_t *values, int width, int height)
+{
+  std::FILE *out = std::fopen(filename.c_str(), "wb");
+  if(!out)
+    return false;
+  bool ok = std::fprintf(out, "P5\n%d %d\n65535\n", width, height) > 0;
+  std::vector<std::uint8_t> row(2*width);
+  for(int y = height - 1; ok && y >= 0; --y) { // top row first, big-endian
+    for(int x = 0; x < width; ++x) {
+      const std::uint16_t v = values[std::size_t(y)*width + x];
+      row[2*x] = v >> 8;
+      row[2*x + 1] = v & 0xff;
+    }
+    ok = std::fwrite(row.data(), 1, row.size(), out) == row.size();
+  }
+  return std::fclose(out) == 0 && ok;
+}
+
+bool savePfm(const std::string &filename, const float *values, int channels, int width, int height)
+{
+  std::FILE *out = std::fopen(filename.c_str(), "wb");
+  if(!out)
+    return false;
+  const std::uint32_t one = 1;
+  const bool littleEndian = *reinterpret_cast<const std::uint8_t *>(&one) == 1;
+  const std::size_t count = std::size_t(channels)*width*height; // bottom row first, as in PFM
+  const bool ok = std::fprintf(out, "%s\n%d %d\n%s\n", channels == 3 ? "PF" : "Pf", width, height,
+                               littleEndian ? "-1.0" : "1.0") > 0 &&
+    std::fwrite(values, sizeof(float), count, out) == count;
+  return std::fclose(out) == 0 && ok;
+}
@@ -0,0 +1,117 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Captures of the rendered frames, without stalling the render loop: the
+// pixels are read into one of kCaptureBuffers pixel buffers in turn, mapped
+// once the GPU is done with them, a few frames later, and written by a pool
+// of threads, either as TGA files or as raw frames piped to an encoder. The
+// attachments of other framebuffers can be dumped the same way, for debug.
+class FrameCapture {
+public:
+  static const int kCaptureBuffers = 3;
+  static const std::size_t kMaxQueuedFrames = 32; // past this, capture() waits for the writers
+
+  explicit FrameCapture(unsigned int numWriters=2);
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+  virtual ~FrameCapture();      // writes the frames in flight
+
+  // Recording: every frame passed to capture() goes to <prefix>00000.tga,
+  // <prefix>00001.tga, ..., or, for startPipe(), to the standard input of
+  // command, as raw bgr24 frames with the bottom row first; "{size}" in
+  // command is replaced by the size, e.g. for ffmpeg:
+  //   ffmpeg -y -f rawvideo -pixel_format bgr24 -video_size {size} -i - -vf vflip out.mp4
+  void startFiles(const std::string &prefix);
+  bool startPipe(const std::string &command, int width, int height);
+  void stop();                  // after the frames in flight
+  bool recording() const { return _recording; }
+
+  // Once per frame, after rendering to the default framebuffer and before
+  // swapping: hands the finished readbacks to the writers, and reads the
+  // frame if recording
+  void update(int width, int height);
+
+  // The current frame to filename, e.g. a screenshot, recording or not
+  void captureOnce(const std::string &filename, int width, int height);
+
+  // An attachment of framebuffer fbo, by the extension of filename: depth as
+  // a 16-bit binary .pgm or a float .pfm, colour as a .tga or a float .pfm.
+  // False, without reading, for another extension.
+  bool dumpAttachment(const std::string &filename, GLuint fbo, GLenum attachment, int width, int height);
+
+private:
+  enum class Encoding { kPipe, kTga, kPgm16, kPfm };
+
+  // What is read and how it is written
+  struct Image {
+    Encoding encoding;
+    GLenum format, type;
+    int channels, bytesPerPixel;
+  };
+  struct Slot {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    GLsizeiptr size = 0;
+    int width = 0, height = 0;
+    Image image;
+    std::string filename;
+  };
+  struct Frame {
+    std::vector<std::uint8_t> pixels;
+    int width, height;
+    Image image;
+    std::string filename;
+    std::uint64_t sequence;     // order of the frames of the pipe
+  };
+
+  static const Image kFrameImage; // bgr bytes, as TGA or to the pipe
+
+  void read(const std::string &filename, const Image &image, int width, int height);
+  bool retire(Slot &slot, bool wait); // false if not read yet, without wait
+  void retireAll();
+  void work();
+  bool pipeFailed();
+  void closePipe();
+
+  Slot _slots[kCaptureBuffers];
+  int _next = 0;
+  bool _recording = false;
+  std::string _prefix;
+  unsigned int _frameCount = 0;
+  int _pipeWidth = 0, _pipeHeight = 0;
+
+  // writers
+  std::vector<std::thread> _writers;
+  std::mutex _mutex;
+  std::condition_variable _queued, _written, _pipeTurn;
+  std::deque<Frame> _queue;
+  std::size_t _inFlight = 0;    // queued or being written
+  bool _quit = false;
+  std::FILE *_pipe = nullptr;
+  std::uint64_t _pipeQueued = 0, _pipeWritten = 0;
+  bool _pipeFailed = false;     // a short write: recording stops at the next update()
+#ifndef _WIN32
+  void (*_sigpipeHandler)(int) = SIG_DFL; // restored once the pipe is closed, SIGPIPE being ignored meanwhile
+  bool _sigpipeIgnored = false;
+#endif
+};
+
+// Images with the bottom row first, as read by OpenGL. Uncompressed 24-bit
+// TGA of bgr pixels; 16-bit binary PGM of a single channel; PFM of 1 or 3
+// float channels.
+bool saveTga(const std::string &filename, const std::uint8_t *bgr, int width, int height);
+bool savePgm16(const std::string &filename, const std::uint16_t *values, int width, int height);
+bool savePfm(const std::string &filename, const float *values, int channels, int width, int height);
+
+#endif  // FRAME_CAPTURE_H
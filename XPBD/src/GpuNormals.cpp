@@ -0,0 +1,155 @@
+#include "GpuNormals.h"
+
+#include <vector>
+
+#include "Mesh.h"
+#include "ShaderProgram.h"
+
+GpuNormals::~GpuNormals()
+{
+  clear();
+}
+
+void GpuNormals::loadProgram(const std::string &shaderFilename)
+{
+  _program = std::make_shared<ShaderProgram>();
+  _program->setBinaryCache(ShaderProgram::binaryCacheFile(shaderFilename));
+#ifdef SUPPORT_OPENGL_45
+  _program->loadShader(GL_COMPUTE_SHADER, shaderFilename);
+#else
+  _program->loadShader(GL_VERTEX_SHADER, shaderFilename);
+  const GLchar *varyings[] = {"normal"};
+  glTransformFeedbackVaryings(_program->id(), 1, varyings, GL_INTERLEAVED_ATTRIBS);
+#endif
+  _program->link();
+}
+
+bool GpuNormals::fits(const Mesh &mesh)
+{
+  const GLint64 n = mesh.vertexPositions().size();
+  const GLint64 adjacency = n + 1 + 6*GLint64(mesh.triangleIndices().size()); // GLuint
+#ifdef SUPPORT_OPENGL_45
+  GLint64 maxBytes = 0;
+  glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBytes);
+  return 4*adjacency <= maxBytes && 12*n <= maxBytes;
+#else
+  // the position texture spans the whole stream buffer, as Mesh::enableStreaming() lays it out
+  const GLint64 positions = Mesh::kStreamFrames*((12*n + 255)/256*256)/4; // GLfloat
+  GLint maxTexels = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+  return adjacency <= maxTexels && positions <= maxTexels;
+#endif
+}
+
+bool GpuNormals::build(const Mesh &mesh)
+{
+  clearBuffers();
+  if(!fits(mesh))
+    return false;
+  const std::vector<glm::uvec3> &T = mesh.triangleIndices();
+  _count = mesh.vertexPositions().size();
+
+  // CSR in one array: the n+1 offsets, then for every corner (i, j, k) of a
+  // triangle the pair (j, k), in the orientation of the triangle
+  std::vector<GLuint> adjacency(_count + 1, 0);
+  for(const auto &t : T)
+    for(int a = 0; a < 3; ++a)
+      adjacency[t[a] + 1] += 2;
+  adjacency[0] = _count + 1;
+  for(GLsizei i = 0; i < _count; ++i)
+    adjacency[i + 1] += adjacency[i];
+  std::vector<GLuint> fill(adjacency.begin(), adjacency.end() - 1);
+  adjacency.resize(adjacency[_count]);
+  for(const auto &t : T) {
+    for(int a = 0; a < 3; ++a) {
+      adjacency[fill[t[a]]++] = t[(a + 1) % 3];
+      adjacency[fill[t[a]]++] = t[(a + 2) % 3];
+    }
+  }
+
+  glGenBuffers(1, &_adjacencyVbo);
+#ifdef SUPPORT_OPENGL_45
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, _adjacencyVbo);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*adjacency.size(), adjacency.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+#else
+  glBindBuffer(GL_TEXTURE_BUFFER, _adjacencyVbo);
+  glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint)*adjacency.size(), adjacency.data(), GL_STATIC_DRAW);
+  glGenTextures(1, &_adjacencyTex);
+  glBindTexture(GL_TEXTURE_BUFFER, _adjacencyTex);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, _adjacencyVbo);
+
+  glGenTextures(1, &_positionTex); // on the stream buffer of the mesh, whole
+  glBindTexture(GL_TEXTURE_BUFFER, _positionTex);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, mesh.streamBuffer());
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  glGenVertexArrays(1, &_vao);  // no attributes, the shader runs on gl_VertexID
+#endif
+  return true;
+}
+
+void GpuNormals::compute(const Mesh &mesh) const
+{
+  if(!_program || _count == 0)
+    return;
+  _program->use();
+#ifdef SUPPORT_OPENGL_45
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, mesh.streamBuffer(), mesh.streamOffset(), 3*sizeof(GLfloat)*_count);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _adjacencyVbo);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mesh.normalBuffer());
+  _program->set("count", GLuint(_count));
+  glDispatchCompute((_count + 63)/64, 1, 1);
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT); // the draws read the normals as attributes
+#else
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, _positionTex);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, _adjacencyTex);
+  _program->set("positions", 0);
+  _program->set("adjacency", 1);
+  _program->set("base", GLint(mesh.streamOffset()/sizeof(GLfloat)));
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, mesh.normalBuffer());
+  glBindVertexArray(_vao);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, _count);
+  glEndTransformFeedback();
+  glBindVertexArray(0);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glDisable(GL_RASTERIZER_DISCARD);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+#endif
+  ShaderProgram::stop();
+}
+
+void GpuNormals::clear()
+{
+  clearBuffers();
+  _program.reset();
+}
+
+void GpuNormals::clearBuffers()
+{
+  if(_vao) {
+    glDeleteVertexArrays(1, &_vao);
+    _vao = 0;
+  }
+  if(_positionTex) {
+    glDeleteTextures(1, &_positionTex);
+    _positionTex = 0;
+  }
+  if(_adjacencyTex) {
+    glDeleteTextures(1, &_adjacencyTex);
+    _adjacencyTex = 0;
+  }
+  if(_adjacencyVbo) {
+    glDeleteBuffers(1, &_adjacencyVbo);
+    _adjacencyVbo = 0;
+  }
+  _count = 0;
+}
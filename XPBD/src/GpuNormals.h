@@ -0,0 +1,53 @@
+#ifndef GPU_NORMALS_H
+#define GPU_NORMALS_H
+
+#include <glad/glad.h>
+#include <memory>
+#include <string>
+
+class Mesh;
+class ShaderProgram;
+
+// Per-vertex normals of a mesh streamed without them
+// (VertexStream::kPositionsOnly), computed on the GPU from the positions of
+// the region drawn and written to the normal buffer of the mesh. Every vertex
+// sums the area-weighted normals of its triangles, as VertexNormals does,
+// from an adjacency buffer built once. With OpenGL 3.3, a vertex shader run
+// under transform feedback reads the positions and the adjacency as buffer
+// textures; with SUPPORT_OPENGL_45, a compute shader reads them as storage
+// buffers.
+class GpuNormals {
+public:
+  GpuNormals() = default;
+  GpuNormals(const GpuNormals &) = delete;
+  GpuNormals &operator=(const GpuNormals &) = delete;
+  virtual ~GpuNormals();
+
+  // The vertex shader of vertexShaderNormals.glsl, or the compute shader of
+  // computeShaderNormals.glsl with SUPPORT_OPENGL_45
+  void loadProgram(const std::string &shaderFilename);
+
+  // Whether the buffers of mesh fit the limits of the context: the buffer
+  // textures of OpenGL 3.3 may hold as few as 65536 texels
+  static bool fits(const Mesh &mesh);
+
+  // Adjacency of the triangles of mesh, whose topology is then fixed; false,
+  // building nothing, if the mesh does not fit
+  bool build(const Mesh &mesh);
+
+  // Normals of the positions streamed last
+  void compute(const Mesh &mesh) const;
+
+  // Releases the buffers and the program
+  void clear();
+
+private:
+  void clearBuffers();
+
+  std::shared_ptr<ShaderProgram> _program;
+  GLuint _adjacencyVbo = 0;     // offsets of the vertices, then the other two vertices of their triangles
+  GLuint _adjacencyTex = 0, _positionTex = 0, _vao = 0; // transform feedback only
+  GLsizei _count = 0;
+};
+
+#endif  // GPU_NORMALS_H
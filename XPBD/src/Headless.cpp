@@ -0,0 +1,108 @@
+#include "Headless.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <iostream>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+HeadlessContext::~HeadlessContext()
+{
+  destroy();
+}
+
+bool HeadlessContext::create()
+{
+  EGLDisplay display = EGL_NO_DISPLAY;
+  const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS); // client extensions
+  if(extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+    const PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if(getPlatformDisplay)
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if(display == EGL_NO_DISPLAY)
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  EGLint major, minor;
+  if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    std::cerr << "[Headless][create] Error: no EGL display" << std::endl;
+    return false;
+  }
+  _display = display;
+  if(!eglBindAPI(EGL_OPENGL_API)) {
+    std::cerr << "[Headless][create] Error: no desktop OpenGL through EGL" << std::endl;
+    destroy();
+    return false;
+  }
+
+  // no surface: a config is only needed by drivers without EGL_KHR_no_config_context
+  const EGLint configAttribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint numConfigs = 0;
+  eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+  const EGLint contextAttribs[] = {
+#ifdef SUPPORT_OPENGL_45
+    EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+#else
+    EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+#endif
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE};
+  EGLContext context = eglCreateContext(display, numConfigs ? config : nullptr, EGL_NO_CONTEXT, contextAttribs);
+  if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    std::cerr << "[Headless][create] Error: cannot make an OpenGL context current, EGL error 0x"
+              << std::hex << eglGetError() << std::dec << std::endl;
+    if(context != EGL_NO_CONTEXT)
+      eglDestroyContext(display, context);
+    destroy();
+    return false;
+  }
+  _context = context;
+  return true;
+}
+
+GLADloadproc HeadlessContext::loader()
+{
+  return reinterpret_cast<GLADloadproc>(eglGetProcAddress);
+}
+
+bool HeadlessContext::allocateFramebuffer(int width, int height)
+{
+  glGenFramebuffers(1, &_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+  glGenRenderbuffers(1, &_colorRbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, _colorRbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorRbo);
+  glGenRenderbuffers(1, &_depthRbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, _depthRbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthRbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if(!complete)
+    std::cerr << "[Headless][allocateFramebuffer] Error: incomplete framebuffer" << std::endl;
+  return complete;
+}
+
+void HeadlessContext::destroy()
+{
+  if(_context) {
+    if(_fbo) {
+      glDeleteFramebuffers(1, &_fbo);
+      glDeleteRenderbuffers(1, &_colorRbo);
+      glDeleteRenderbuffers(1, &_depthRbo);
+      _fbo = _colorRbo = _depthRbo = 0;
+    }
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(_display, _context);
+    _context = nullptr;
+  }
+  if(_display) {
+    eglTerminate(_display);
+    _display = nullptr;
+  }
+}
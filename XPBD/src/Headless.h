@@ -0,0 +1,36 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+// OpenGL without a display, for batch rendering: an EGL context without any
+// surface, on Mesa's surfaceless platform when there is one (llvmpipe on
+// CPU-only machines, or a GPU through its render node), on the default EGL
+// display otherwise. The frames go to a framebuffer of the requested size.
+class HeadlessContext {
+public:
+  HeadlessContext() = default;
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext &operator=(const HeadlessContext &) = delete;
+  virtual ~HeadlessContext();
+
+  // Makes a core OpenGL 3.3 context current, 4.5 with SUPPORT_OPENGL_45;
+  // false, with the reason on std::cerr, on failure
+  bool create();
+
+  // For gladLoadGLLoader, once the context is current
+  static GLADloadproc loader();
+
+  // Colour (RGBA8) and depth (24 bits) to render to, after gladLoadGLLoader
+  bool allocateFramebuffer(int width, int height);
+  GLuint framebuffer() const { return _fbo; }
+
+  void destroy();
+
+private:
+  void *_display = nullptr;     // EGLDisplay and EGLContext, EGL being
+  void *_context = nullptr;     // included by the implementation only
+  GLuint _fbo = 0, _colorRbo = 0, _depthRbo = 0;
+};
+
+#endif  // HEADLESS_H
@@ -0,0 +1,376 @@
+// ----------------------------------------------------------------------------
+// LinearizedXpbd.hpp
+//
+// Description: XPBD step solving for all the Lagrange multiplier increments at
+//              once: every outer iteration linearizes the stretch and bend
+//              constraints and solves (J W J^T + alpha) dlambda = b by a
+//              matrix-free block-Jacobi preconditioned conjugate gradient
+// ----------------------------------------------------------------------------
+
+#ifndef _LINEARIZEDXPBD_HPP_
+#define _LINEARIZEDXPBD_HPP_
+
+#include <cmath>
+#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "NeighborGrid.hpp"
+
+// The Jacobian is stored flat and SoA: stretch constraint c owns the slots
+// 2c and 2c+1, bend constraint b the four slots after all the stretch ones.
+// A slot is a vertex id and the gradient of its constraint wrt that vertex.
+class LinearizedXpbd {
+public:
+  // Constraints whose vertices are all pinned (w = 0) are dropped. Stretch
+  // constraints are grouped by triangle into the preconditioner blocks.
+  void build(
+    const std::vector<glm::vec3> &x, const std::vector<tReal> &w,
+    const std::vector<glm::uvec3> &triangles,
+    const std::vector<glm::uvec2> &edges, const std::vector<glm::uvec4> &hinges,
+    const tReal k_stretch, const tReal k_bend, const tReal damp_stretch, const tReal damp_bend)
+  {
+    const tUint n = x.size();
+    _slot_v.clear();
+    _rest.clear();
+    _alpha.clear();
+    _damp.clear();
+
+    std::map<std::pair<tUint, tUint>, int> edge_id;
+    for(const auto &e : edges) {
+      if(w[e[0]] == 0.f && w[e[1]] == 0.f)
+        continue;
+      edge_id[std::make_pair(std::min(e[0], e[1]), std::max(e[0], e[1]))] = _rest.size();
+      _slot_v.push_back(e[0]);
+      _slot_v.push_back(e[1]);
+      _rest.push_back(glm::length(x[e[0]] - x[e[1]]));
+      _alpha.push_back(k_stretch);
+      _damp.push_back(damp_stretch);
+    }
+    _num_stretch = _rest.size();
+    for(const auto &h : hinges) {
+      if(w[h[0]] == 0.f && w[h[1]] == 0.f && w[h[2]] == 0.f && w[h[3]] == 0.f)
+        continue;
+      for(int s = 0; s < 4; ++s)
+        _slot_v.push_back(h[s]);
+      tReal d;
+      glm::vec3 g[4];
+      bendGradients(x, h[0], h[1], h[2], h[3], d, g);
+      _rest.push_back(std::acos(glm::clamp(d, -1.f, 1.f)));
+      _alpha.push_back(k_bend);
+      _damp.push_back(damp_bend);
+    }
+    const tUint m = _rest.size();
+
+    // preconditioner blocks: the up to three edges of a triangle not taken by
+    // a previous one, then every bend on its own
+    std::vector<bool> taken(_num_stretch, false);
+    _blocks.clear();
+    for(const auto &t : triangles) {
+      glm::ivec3 block(-1);
+      int size = 0;
+      for(int k = 0; k < 3; ++k) {
+        const auto it = edge_id.find(std::make_pair(std::min(t[k], t[(k+1)%3]), std::max(t[k], t[(k+1)%3])));
+        if(it != edge_id.end() && !taken[it->second]) {
+          taken[it->second] = true;
+          block[size++] = it->second;
+        }
+      }
+      if(size > 0)
+        _blocks.push_back(block);
+    }
+    for(tUint c = 0; c < _num_stretch; ++c)
+      if(!taken[c])
+        _blocks.push_back(glm::ivec3(c, -1, -1));
+    for(tUint c = _num_stretch; c < m; ++c)
+      _blocks.push_back(glm::ivec3(c, -1, -1));
+    _block_inv.resize(_blocks.size());
+
+    // slots around every vertex, for the gather of W J^T v
+    const tUint num_slots = _slot_v.size();
+    _slot_c.resize(num_slots);
+    for(tUint c = 0; c < _num_stretch; ++c)
+      _slot_c[2*c] = _slot_c[2*c + 1] = c;
+    for(tUint c = _num_stretch; c < m; ++c)
+      for(int s = 0; s < 4; ++s)
+        _slot_c[firstSlot(c) + s] = c;
+    _vertex_start.assign(n + 1, 0);
+    for(tUint k = 0; k < num_slots; ++k)
+      ++_vertex_start[_slot_v[k]];
+    exclusiveScan(_vertex_start);
+    _vertex_slots.resize(num_slots);
+    std::vector<tUint> cursor(_vertex_start.begin(), _vertex_start.end() - 1);
+    for(tUint k = 0; k < num_slots; ++k)
+      _vertex_slots[cursor[_slot_v[k]]++] = k;
+
+    for(int a = 0; a < 3; ++a) _j[a].resize(num_slots);
+    _C.resize(m);
+    _lambda.resize(m);
+    _alpha_t.resize(m);
+    _b.resize(m);
+    _dl.resize(m);
+    _r.resize(m);
+    _z.resize(m);
+    _p.resize(m);
+    _Ap.resize(m);
+    _u.resize(n);
+  }
+
+  tUint size() const { return _rest.size(); }
+
+  // Number of Jacobian products (constraint passes) of the last solve()
+  tUint numPasses() const { return _num_passes; }
+
+  void solve(
+    std::vector<glm::vec3> &x, const std::vector<glm::vec3> &x_last, const std::vector<tReal> &w,
+    const tReal dt, const int num_outer, const int num_cg)
+  {
+    const int m = size(), n = x.size();
+    const tReal inv_dt2 = 1.f / (dt*dt);
+    std::fill(_lambda.begin(), _lambda.end(), 0.f);
+    _num_passes = 0;
+
+    for(int outer = 0; outer < num_outer; ++outer) {
+      linearize(x);
+
+      // right-hand side; the rows are divided by (1 + gamma) so that the
+      // damped system stays symmetric
+      // b = (-C - alpha~ lambda - gamma J (x - x_last)) / (1 + gamma)
+#pragma omp parallel for
+      for(int i = 0; i < n; ++i)
+        _u[i] = x[i] - x_last[i];
+      jacobianProduct(_u, _Ap);
+#pragma omp parallel for
+      for(int c = 0; c < m; ++c) {
+        const tReal alpha_t = _alpha[c]*inv_dt2;
+        const tReal gamma = alpha_t*_damp[c]*dt;
+        _alpha_t[c] = alpha_t / (1.f + gamma);
+        _b[c] = (-_C[c] - alpha_t*_lambda[c] - gamma*_Ap[c]) / (1.f + gamma);
+      }
+
+      updatePreconditioner(w);
+      conjugateGradient(w, num_cg);
+
+      // x += W J^T dlambda
+      transposeProduct(w, _dl, _u);
+#pragma omp parallel for
+      for(int i = 0; i < n; ++i)
+        x[i] += _u[i];
+#pragma omp parallel for simd
+      for(int c = 0; c < m; ++c)
+        _lambda[c] += _dl[c];
+    }
+  }
+
+private:
+  tUint firstSlot(const tUint c) const
+  {
+    return c < _num_stretch ? 2*c : 2*_num_stretch + 4*(c - _num_stretch);
+  }
+
+  // Same gradients as ConstraintBend, dd/dx_k / sqrt(1 - d^2) with d the
+  // cosine of the dihedral angle
+  static void bendGradients(
+    const std::vector<glm::vec3> &x, const tUint i1, const tUint i2, const tUint i3, const tUint i4,
+    tReal &d, glm::vec3 g[4])
+  {
+    const glm::vec3 p2 = x[i2] - x[i1];
+    const glm::vec3 p3 = x[i3] - x[i1];
+    const glm::vec3 p4 = x[i4] - x[i1];
+    const glm::vec3 c3 = glm::cross(p2, p3), c4 = glm::cross(p2, p4);
+    const tReal p2xp3_len = glm::length(c3) + 1e-5f;
+    const tReal p2xp4_len = glm::length(c4) + 1e-5f;
+    const glm::vec3 n1 = c3 / p2xp3_len;
+    const glm::vec3 n2 = c4 / p2xp4_len;
+    d = glm::clamp(glm::dot(n1, n2), -1.f, 1.f);
+    const tReal s = std::sqrt(1.f - d*d);
+    if(s < 1e-5f) {
+      g[0] = g[1] = g[2] = g[3] = glm::vec3(0.f);
+      return;
+    }
+    g[2] = (glm::cross(p2, n2) + glm::cross(n1, p2)*d) / p2xp3_len / s;
+    g[3] = (glm::cross(p2, n1) + glm::cross(n2, p2)*d) / p2xp4_len / s;
+    g[1] = (-(glm::cross(p3, n2) + glm::cross(n1, p3)*d) / p2xp3_len
+            -(glm::cross(p4, n1) + glm::cross(n2, p4)*d) / p2xp4_len) / s;
+    g[0] = -g[1] - g[2] - g[3];
+  }
+
+  // Constraint values and Jacobian at x
+  void linearize(const std::vector<glm::vec3> &x)
+  {
+    const int ms = _num_stretch, m = size();
+#pragma omp parallel for
+    for(int c = 0; c < ms; ++c) {
+      const glm::vec3 diff = x[_slot_v[2*c]] - x[_slot_v[2*c + 1]];
+      const tReal len = glm::length(diff);
+      const glm::vec3 n = len > 1e-9f ? diff/len : glm::vec3(0.f);
+      _C[c] = len - _rest[c];
+      for(int a = 0; a < 3; ++a) {
+        _j[a][2*c] = n[a];
+        _j[a][2*c + 1] = -n[a];
+      }
+    }
+#pragma omp parallel for
+    for(int c = ms; c < m; ++c) {
+      const tUint k = firstSlot(c);
+      tReal d;
+      glm::vec3 g[4];
+      bendGradients(x, _slot_v[k], _slot_v[k+1], _slot_v[k+2], _slot_v[k+3], d, g);
+      _C[c] = std::acos(d) - _rest[c];
+      for(int s = 0; s < 4; ++s)
+        for(int a = 0; a < 3; ++a)
+          _j[a][k + s] = g[s][a];
+    }
+  }
+
+  // y = J u
+  void jacobianProduct(const std::vector<glm::vec3> &u, std::vector<tReal> &y)
+  {
+    const int ms = _num_stretch, m = size();
+    const tReal *jx = _j[0].data(), *jy = _j[1].data(), *jz = _j[2].data();
+    const tUint *v = _slot_v.data();
+#pragma omp parallel for simd
+    for(int c = 0; c < ms; ++c) {
+      const glm::vec3 &u0 = u[v[2*c]], &u1 = u[v[2*c + 1]];
+      y[c] = jx[2*c]*u0[0] + jy[2*c]*u0[1] + jz[2*c]*u0[2]
+           + jx[2*c + 1]*u1[0] + jy[2*c + 1]*u1[1] + jz[2*c + 1]*u1[2];
+    }
+#pragma omp parallel for
+    for(int c = ms; c < m; ++c) {
+      const tUint k = firstSlot(c);
+      tReal sum = 0.f;
+      for(tUint s = k; s < k + 4; ++s)
+        sum += jx[s]*u[v[s]][0] + jy[s]*u[v[s]][1] + jz[s]*u[v[s]][2];
+      y[c] = sum;
+    }
+    ++_num_passes;
+  }
+
+  // u = W J^T l, gathered per vertex
+  void transposeProduct(const std::vector<tReal> &w, const std::vector<tReal> &l, std::vector<glm::vec3> &u)
+  {
+    const int n = u.size();
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      glm::vec3 sum(0.f);
+      for(tUint q = _vertex_start[i]; q < _vertex_start[i+1]; ++q) {
+        const tUint k = _vertex_slots[q];
+        sum += l[_slot_c[k]]*glm::vec3(_j[0][k], _j[1][k], _j[2][k]);
+      }
+      u[i] = w[i]*sum;
+    }
+  }
+
+  // y = (J W J^T + alpha~) p
+  void systemProduct(const std::vector<tReal> &w, const std::vector<tReal> &p, std::vector<tReal> &y)
+  {
+    const int m = size();
+    transposeProduct(w, p, _u);
+    jacobianProduct(_u, y);
+#pragma omp parallel for simd
+    for(int c = 0; c < m; ++c)
+      y[c] += _alpha_t[c]*p[c];
+  }
+
+  // Blocks of J W J^T + alpha~, inverted; unused rows of a block are identity
+  void updatePreconditioner(const std::vector<tReal> &w)
+  {
+    const int nb = _blocks.size();
+#pragma omp parallel for
+    for(int b = 0; b < nb; ++b) {
+      const glm::ivec3 &blk = _blocks[b];
+      glm::mat3 B(1.f);
+      for(int r = 0; r < 3 && blk[r] >= 0; ++r) {
+        for(int c = 0; c < 3 && blk[c] >= 0; ++c) {
+          tReal sum = r == c ? _alpha_t[blk[r]] : 0.f;
+          const tUint kr = firstSlot(blk[r]), kc = firstSlot(blk[c]);
+          const tUint nr = blk[r] < (int)_num_stretch ? 2 : 4, nc = blk[c] < (int)_num_stretch ? 2 : 4;
+          for(tUint sr = kr; sr < kr + nr; ++sr)
+            for(tUint sc = kc; sc < kc + nc; ++sc)
+              if(_slot_v[sr] == _slot_v[sc])
+                sum += w[_slot_v[sr]]*(_j[0][sr]*_j[0][sc] + _j[1][sr]*_j[1][sc] + _j[2][sr]*_j[2][sc]);
+          B[c][r] = sum;
+        }
+      }
+      _block_inv[b] = std::abs(glm::determinant(B)) > 1e-20f ? glm::inverse(B) : glm::mat3(1.f);
+    }
+  }
+
+  void applyPreconditioner(const std::vector<tReal> &r, std::vector<tReal> &z)
+  {
+    const int nb = _blocks.size();
+#pragma omp parallel for
+    for(int b = 0; b < nb; ++b) {
+      const glm::ivec3 &blk = _blocks[b];
+      const glm::vec3 rb(r[blk[0]], blk[1] >= 0 ? r[blk[1]] : 0.f, blk[2] >= 0 ? r[blk[2]] : 0.f);
+      const glm::vec3 zb = _block_inv[b]*rb;
+      for(int k = 0; k < 3 && blk[k] >= 0; ++k)
+        z[blk[k]] = zb[k];
+    }
+  }
+
+  static tReal dot(const std::vector<tReal> &a, const std::vector<tReal> &b)
+  {
+    const int m = a.size();
+    double sum = 0.0;
+#pragma omp parallel for simd reduction(+:sum)
+    for(int c = 0; c < m; ++c)
+      sum += a[c]*b[c];
+    return sum;
+  }
+
+  // dl = (J W J^T + alpha~)^-1 b, from dl = 0
+  void conjugateGradient(const std::vector<tReal> &w, const int num_iterations)
+  {
+    const int m = size();
+    std::fill(_dl.begin(), _dl.end(), 0.f);
+    _r = _b;
+    applyPreconditioner(_r, _z);
+    _p = _z;
+    tReal rz = dot(_r, _z);
+    const tReal tol = 1e-12f*dot(_b, _b);
+
+    for(int it = 0; it < num_iterations && rz > 0.f; ++it) {
+      systemProduct(w, _p, _Ap);
+      const tReal pAp = dot(_p, _Ap);
+      if(pAp <= 0.f)
+        break;
+      const tReal a = rz / pAp;
+#pragma omp parallel for simd
+      for(int c = 0; c < m; ++c) {
+        _dl[c] += a*_p[c];
+        _r[c] -= a*_Ap[c];
+      }
+      if(dot(_r, _r) <= tol)
+        break;
+      applyPreconditioner(_r, _z);
+      const tReal rz_next = dot(_r, _z);
+      const tReal beta = rz_next / rz;
+      rz = rz_next;
+#pragma omp parallel for simd
+      for(int c = 0; c < m; ++c)
+        _p[c] = _z[c] + beta*_p[c];
+    }
+  }
+
+  tUint _num_stretch = 0;
+  std::vector<tReal> _rest, _alpha, _damp; // rest length or angle, compliance, damping
+
+  // flat Jacobian
+  std::vector<tUint> _slot_v, _slot_c; // vertex and constraint of every slot
+  std::vector<tReal> _j[3];            // gradient components
+  std::vector<tUint> _vertex_start, _vertex_slots; // slots of vertex i: _vertex_slots[_vertex_start[i] .. _vertex_start[i+1]]
+
+  std::vector<glm::ivec3> _blocks;     // constraint ids, -1 if unused
+  std::vector<glm::mat3> _block_inv;
+
+  std::vector<tReal> _C, _lambda, _alpha_t, _b;
+  std::vector<tReal> _dl, _r, _z, _p, _Ap; // conjugate gradient
+  std::vector<glm::vec3> _u;
+  tUint _num_passes = 0;
+};
+
+#endif  /* _LINEARIZEDXPBD_HPP_ */
@@ -0,0 +1,230 @@
+// ----------------------------------------------------------------------------
+// LoopSubdivision.hpp
+//
+// Description: Loop subdivision [Loop 1987] of a triangle mesh of fixed
+//              topology, to render a smooth surface over the simulated one
+// ----------------------------------------------------------------------------
+
+#ifndef _LOOPSUBDIVISION_HPP_
+#define _LOOPSUBDIVISION_HPP_
+
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "MeshTopology.hpp"
+#include "NeighborGrid.hpp"
+#include "VertexNormals.hpp"
+
+// Every subdivided vertex is a fixed linear combination of the vertices of the
+// input mesh. build() composes the stencils of all the levels into one sparse
+// matrix, in CSR form, and the fine triangles; subdividing is then a parallel
+// sparse matrix-vector product, one row per fine vertex. Boundary edges and
+// edges of more than two triangles are creases, with the boundary rules of
+// [Hoppe et al. 1994]; vertices where more than two of them meet are corners
+// and stay in place.
+class LoopSubdivision {
+public:
+  tUint size() const { return _start.empty() ? 0 : _start.size() - 1; }
+  const std::vector<glm::uvec3> &triangles() const { return _triangles; }
+
+  void build(const tUint num_vertices, const std::vector<glm::uvec3> &triangles, const int levels)
+  {
+    // identity, then one level at a time
+    _start.resize(num_vertices + 1);
+    _cols.resize(num_vertices);
+    _w.assign(num_vertices, 1.f);
+    for(tUint i = 0; i < num_vertices; ++i) {
+      _start[i] = i;
+      _cols[i] = i;
+    }
+    _start[num_vertices] = num_vertices;
+    _triangles = triangles;
+
+    std::vector<tUint> start, cols;
+    std::vector<tReal> w;
+    for(int l = 0; l < levels; ++l) {
+      const tUint n = size();
+      subdivideOnce(n, start, cols, w);
+      compose(start, cols, w, num_vertices);
+    }
+    _normals.build(size(), _triangles);
+  }
+
+  // fine[i] = sum of the stencil of row i over the input values
+  template <typename V>
+  void apply(const std::vector<V> &coarse, V *fine) const
+  {
+    const int n = size();
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      V v(0.f);
+      for(tUint k = _start[i]; k < _start[i+1]; ++k)
+        v += _w[k]*coarse[_cols[k]];
+      fine[i] = v;
+    }
+  }
+
+  // Positions, and the normals of the subdivided surface
+  void refine(const std::vector<glm::vec3> &x, std::vector<glm::vec3> &fine_x, std::vector<glm::vec3> &fine_n)
+  {
+    fine_x.resize(size());
+    apply(x, fine_x.data());
+    _normals.compute(fine_x, fine_n);
+  }
+
+private:
+  // Stencils of one level over the current mesh of n vertices, in terms of
+  // its vertices, and the triangles of the next level. The n even vertices
+  // keep their index and the new vertex of edge e is n + e.
+  void subdivideOnce(const tUint n, std::vector<tUint> &start, std::vector<tUint> &cols, std::vector<tReal> &w)
+  {
+    buildMeshTopology(_triangles, _topology, _half_edges);
+    const tUint ne = _topology.edges.size();
+
+    // edge of every half-edge, opposite vertices of the interior edges, and
+    // the crease edges at every vertex
+    _edge_of.resize(_half_edges.size());
+    _opposite.assign(ne, glm::uvec2(0));
+    _interior.assign(ne, false);
+    _creases.assign(n, 0);
+    for(tUint k = 0, e = 0; k < _half_edges.size(); ++e) {
+      tUint end = k + 1;
+      while(end < _half_edges.size() && _half_edges[end][0] == _half_edges[k][0] && _half_edges[end][1] == _half_edges[k][1])
+        ++end;
+      for(tUint h = k; h < end; ++h)
+        _edge_of[_half_edges[h][2]] = e;
+      if(end - k == 2) {
+        _interior[e] = true;
+        _opposite[e] = glm::uvec2(_half_edges[k][3], _half_edges[k+1][3]);
+      } else {
+        ++_creases[_half_edges[k][0]];
+        ++_creases[_half_edges[k][1]];
+      }
+      k = end;
+    }
+
+    // edges at every vertex
+    _ring_start.assign(n + 1, 0);
+    for(const auto &e : _topology.edges) {
+      ++_ring_start[e[0]];
+      ++_ring_start[e[1]];
+    }
+    exclusiveScan(_ring_start);
+    _ring.resize(_ring_start[n]);
+    _fill.assign(_ring_start.begin(), _ring_start.end() - 1);
+    for(tUint e = 0; e < ne; ++e) {
+      _ring[_fill[_topology.edges[e][0]]++] = e;
+      _ring[_fill[_topology.edges[e][1]]++] = e;
+    }
+
+    start.assign(1, 0);
+    cols.clear();
+    w.clear();
+    const auto add = [&](const tUint i, const tReal weight) {
+      cols.push_back(i);
+      w.push_back(weight);
+    };
+    for(tUint v = 0; v < n; ++v) {
+      const tUint valence = _ring_start[v+1] - _ring_start[v];
+      if(_creases[v] == 0 && valence > 0) {
+        const tReal c = 0.375f + 0.25f*std::cos(2.f*tReal(M_PI)/valence);
+        const tReal beta = (0.625f - c*c) / valence;
+        add(v, 1.f - valence*beta);
+        for(tUint k = _ring_start[v]; k < _ring_start[v+1]; ++k)
+          add(other(_ring[k], v), beta);
+      } else if(_creases[v] == 2) {
+        add(v, 0.75f);
+        for(tUint k = _ring_start[v]; k < _ring_start[v+1]; ++k)
+          if(!_interior[_ring[k]])
+            add(other(_ring[k], v), 0.125f);
+      } else {
+        add(v, 1.f);
+      }
+      start.push_back(cols.size());
+    }
+    for(tUint e = 0; e < ne; ++e) {
+      const glm::uvec2 &edge = _topology.edges[e];
+      if(_interior[e]) {
+        add(edge[0], 0.375f);
+        add(edge[1], 0.375f);
+        add(_opposite[e][0], 0.125f);
+        add(_opposite[e][1], 0.125f);
+      } else {
+        add(edge[0], 0.5f);
+        add(edge[1], 0.5f);
+      }
+      start.push_back(cols.size());
+    }
+
+    // four triangles per triangle, in the same orientation
+    const tUint nt = _triangles.size();
+    _triangles.resize(4*nt);
+    for(tUint t = 0; t < nt; ++t) {
+      const glm::uvec3 v = _triangles[t];
+      const glm::uvec3 m(n + _edge_of[3*t], n + _edge_of[3*t + 1], n + _edge_of[3*t + 2]);
+      _triangles[t] = glm::uvec3(v[0], m[0], m[2]);
+      _triangles[nt + 3*t] = glm::uvec3(v[1], m[1], m[0]);
+      _triangles[nt + 3*t + 1] = glm::uvec3(v[2], m[2], m[1]);
+      _triangles[nt + 3*t + 2] = m;
+    }
+  }
+
+  tUint other(const tUint e, const tUint v) const
+  {
+    const glm::uvec2 &edge = _topology.edges[e];
+    return edge[0] == v ? edge[1] : edge[0];
+  }
+
+  // Replaces the stencils by the level ones applied to them: (start, cols, w)
+  // are rows over the current vertices, which are rows over the input ones
+  void compose(const std::vector<tUint> &start, const std::vector<tUint> &cols, const std::vector<tReal> &w, const tUint num_inputs)
+  {
+    std::vector<tUint> new_start(1, 0), new_cols;
+    std::vector<tReal> new_w;
+    _acc.assign(num_inputs, 0.f);
+    _mark.assign(num_inputs, false);
+    for(tUint r = 0; r + 1 < start.size(); ++r) {
+      const tUint row_begin = new_cols.size();
+      for(tUint k = start[r]; k < start[r+1]; ++k) {
+        const tUint j = cols[k];
+        for(tUint q = _start[j]; q < _start[j+1]; ++q) {
+          const tUint c = _cols[q];
+          if(!_mark[c]) {
+            _mark[c] = true;
+            new_cols.push_back(c);
+          }
+          _acc[c] += w[k]*_w[q];
+        }
+      }
+      for(tUint q = row_begin; q < new_cols.size(); ++q) {
+        new_w.push_back(_acc[new_cols[q]]);
+        _acc[new_cols[q]] = 0.f;
+        _mark[new_cols[q]] = false;
+      }
+      new_start.push_back(new_cols.size());
+    }
+    _start.swap(new_start);
+    _cols.swap(new_cols);
+    _w.swap(new_w);
+  }
+
+  // stencils of the fine vertices over the input ones
+  std::vector<tUint> _start, _cols;
+  std::vector<tReal> _w;
+  std::vector<glm::uvec3> _triangles;
+  VertexNormals _normals;
+
+  // scratch of build()
+  MeshTopology _topology;
+  std::vector<glm::uvec4> _half_edges;
+  std::vector<tUint> _edge_of, _ring_start, _ring, _fill;
+  std::vector<glm::uvec2> _opposite;
+  std::vector<bool> _interior;
+  std::vector<int> _creases;
+  std::vector<tReal> _acc;
+  std::vector<bool> _mark;
+};
+
+#endif  /* _LOOPSUBDIVISION_HPP_ */
@@ -0,0 +1,85 @@
+#include "MappedFile.h"
+
+#include <ios>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &filename)
+{
+  _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(_file == INVALID_HANDLE_VALUE) {
+    _file = nullptr;
+    throw std::ios_base::failure("[MappedFile] Cannot open " + filename);
+  }
+  LARGE_INTEGER size;
+  GetFileSizeEx(_file, &size);
+  _size = size.QuadPart;
+  if(_size == 0)
+    return;                     // nothing to map
+  _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(_mapping)
+    _data = static_cast<const char *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+  if(!_data) {
+    close();
+    throw std::ios_base::failure("[MappedFile] Cannot map " + filename);
+  }
+}
+
+void MappedFile::close()
+{
+  if(_data) UnmapViewOfFile(_data);
+  if(_mapping) CloseHandle(_mapping);
+  if(_file) CloseHandle(_file);
+  _data = nullptr;
+  _mapping = _file = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filename)
+{
+  _fd = open(filename.c_str(), O_RDONLY);
+  if(_fd < 0)
+    throw std::ios_base::failure("[MappedFile] Cannot open " + filename);
+  struct stat st;
+  if(fstat(_fd, &st) != 0) {
+    close();
+    throw std::ios_base::failure("[MappedFile] Cannot stat " + filename);
+  }
+  _size = st.st_size;
+  if(_size == 0)
+    return;                     // mmap refuses empty ranges
+  void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if(p == MAP_FAILED) {
+    close();
+    throw std::ios_base::failure("[MappedFile] Cannot map " + filename);
+  }
+  madvise(p, _size, MADV_SEQUENTIAL);
+  _data = static_cast<const char *>(p);
+}
+
+void MappedFile::close()
+{
+  if(_data) munmap(const_cast<char *>(_data), _size);
+  if(_fd >= 0) ::close(_fd);
+  _data = nullptr;
+  _fd = -1;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file, for the loaders that parse large
+// inputs in place. Throws std::ios_base::failure when the file cannot be
+// opened or mapped.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &filename);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *begin() const { return _data; }
+  const char *end() const { return _data + _size; }
+  std::size_t size() const { return _size; }
+
+private:
+  void close();
+
+  const char *_data = nullptr;
+  std::size_t _size = 0;
+#ifdef _WIN32
+  void *_file = nullptr;
+  void *_mapping = nullptr;
+#else
+  int _fd = -1;
+#endif
+};
+
+#endif  // MAPPED_FILE_H
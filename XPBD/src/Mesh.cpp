@@ -1,276 +1,17 @@
-#define _USE_MATH_DEFINES
-
 #include "Mesh.h"
 
-#include <cmath>
-#include <algorithm>
-#include <iostream>
-#include <fstream>
-#include <exception>
-#include <ios>
-#include <string>
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "VertexPacking.hpp"
 
 Mesh::~Mesh()
 {
   clear();
 }
 
-void Mesh::computeBoundingSphere(glm::vec3 &center, float &radius) const
-{
-  center = glm::vec3(0.0);
-  radius = 0.f;
-  for(const auto &p : _vertexPositions)
-    center += p;
-  center /= _vertexPositions.size();
-  for(const auto &p : _vertexPositions)
-    radius = std::max(radius, distance(center, p));
-}
-
-void Mesh::recomputePerVertexNormals(bool angleBased)
-{
-  _vertexNormals.clear();
-  // Change the following code to compute a proper per-vertex normal
-  _vertexNormals.resize(_vertexPositions.size(), glm::vec3(0.0, 0.0, 0.0));
-
-  for(unsigned int tIt=0 ; tIt < _triangleIndices.size() ; ++tIt) {
-    glm::uvec3 t = _triangleIndices[tIt];
-    glm::vec3 n_t = glm::cross(
-      _vertexPositions[t[1]] - _vertexPositions[t[0]],
-      _vertexPositions[t[2]] - _vertexPositions[t[0]]);
-    _vertexNormals[t[0]] += n_t;
-    _vertexNormals[t[1]] += n_t;
-    _vertexNormals[t[2]] += n_t;
-  }
-  for(unsigned int nIt = 0 ; nIt < _vertexNormals.size() ; ++nIt) {
-    glm::normalize(_vertexNormals[nIt]);
-  }
-}
-
-void Mesh::recomputePerVertexTextureCoordinates()
-{
-  _vertexTexCoords.clear();
-  // Change the following code to compute a proper per-vertex texture coordinates
-  _vertexTexCoords.resize(_vertexPositions.size(), glm::vec2(0.0, 0.0));
-
-  float xMin = FLT_MAX, xMax = FLT_MIN;
-  float yMin = FLT_MAX, yMax = FLT_MIN;
-  for(glm::vec3 &p : _vertexPositions) {
-    xMin = std::min(xMin, p[0]);
-    xMax = std::max(xMax, p[0]);
-    yMin = std::min(yMin, p[1]);
-    yMax = std::max(yMax, p[1]);
-  }
-  for(unsigned int pIt = 0 ; pIt < _vertexTexCoords.size() ; ++pIt) {
-    _vertexTexCoords[pIt] = glm::vec2(
-      (_vertexPositions[pIt][0] - xMin)/(xMax-xMin),
-      (_vertexPositions[pIt][1] - yMin)/(yMax-yMin));
-  }
-}
-
-void Mesh::addPlane(const float square_half_side)
-{
-  _vertexPositions.push_back(glm::vec3(-square_half_side,-square_half_side, 0));
-  _vertexPositions.push_back(glm::vec3(+square_half_side,-square_half_side, 0));
-  _vertexPositions.push_back(glm::vec3(+square_half_side,+square_half_side, 0));
-  _vertexPositions.push_back(glm::vec3(-square_half_side,+square_half_side, 0));
-
-  _vertexTexCoords.push_back(glm::vec2(0.0, 0.0));
-  _vertexTexCoords.push_back(glm::vec2(1.0, 0.0));
-  _vertexTexCoords.push_back(glm::vec2(1.0, 1.0));
-  _vertexTexCoords.push_back(glm::vec2(0.0, 1.0));
-
-  _vertexNormals.push_back(glm::vec3(0,0, 1));
-  _vertexNormals.push_back(glm::vec3(0,0, 1));
-  _vertexNormals.push_back(glm::vec3(0,0, 1));
-  _vertexNormals.push_back(glm::vec3(0,0, 1));
-
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-}
-
-void Mesh::addBox(const float w, const float h, const float d)
-{
-  // back
-  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, -0.5*d));
-  _vertexTexCoords.push_back(glm::vec2(2.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 3.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(2.0, 3.0)*0.25f);
-  _vertexNormals.push_back(glm::vec3(0, 0, -1));
-  _vertexNormals.push_back(glm::vec3(0, 0, -1));
-  _vertexNormals.push_back(glm::vec3(0, 0, -1));
-  _vertexNormals.push_back(glm::vec3(0, 0, -1));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-
-  // front
-  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, +0.5*d));
-  _vertexTexCoords.push_back(glm::vec2(0.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(1.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(1.0, 3.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(0.0, 3.0)*0.25f);
-  _vertexNormals.push_back(glm::vec3(0, 0, 1));
-  _vertexNormals.push_back(glm::vec3(0, 0, 1));
-  _vertexNormals.push_back(glm::vec3(0, 0, 1));
-  _vertexNormals.push_back(glm::vec3(0, 0, 1));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-
-  // bottom
-  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, +0.5*d));
-  _vertexTexCoords.push_back(glm::vec2(2.0, 3.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 3.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 4.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(2.0, 4.0)*0.25f);
-  _vertexNormals.push_back(glm::vec3(0, -1, 0));
-  _vertexNormals.push_back(glm::vec3(0, -1, 0));
-  _vertexNormals.push_back(glm::vec3(0, -1, 0));
-  _vertexNormals.push_back(glm::vec3(0, -1, 0));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-
-  // top
-  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, -0.5*d));
-  _vertexTexCoords.push_back(glm::vec2(2.0, 1.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 1.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(2.0, 2.0)*0.25f);
-  _vertexNormals.push_back(glm::vec3(0, 1, 0));
-  _vertexNormals.push_back(glm::vec3(0, 1, 0));
-  _vertexNormals.push_back(glm::vec3(0, 1, 0));
-  _vertexNormals.push_back(glm::vec3(0, 1, 0));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-
-  // left
-  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, -0.5*d));
-  _vertexTexCoords.push_back(glm::vec2(1.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(2.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(2.0, 3.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(1.0, 3.0)*0.25f);
-  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
-  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
-  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
-  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-
-  // right
-  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, +0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, -0.5*d));
-  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, +0.5*d));
-  _vertexTexCoords.push_back(glm::vec2(3.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(4.0, 2.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(4.0, 3.0)*0.25f);
-  _vertexTexCoords.push_back(glm::vec2(3.0, 3.0)*0.25f);
-  _vertexNormals.push_back(glm::vec3(1, 0, 0));
-  _vertexNormals.push_back(glm::vec3(1, 0, 0));
-  _vertexNormals.push_back(glm::vec3(1, 0, 0));
-  _vertexNormals.push_back(glm::vec3(1, 0, 0));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
-  _triangleIndices.push_back(
-    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
-}
-
-void Mesh::addCloth(const GLuint rx, const GLuint rz, const float w, const float h)
-{
-  // TODO - done: create a rw x rh resolution mesh (with size of w x h)
-
-  float start_x = -0.5 * w;
-  float start_z = -0.5 * h;
-  float x_step = w / (rx - 1);
-  float z_step = h / (rz - 1);
-
-  for (int x_i = 0; x_i < rx; ++x_i) {
-    for (int z_i = 0; z_i < rz; ++z_i) {
-      _vertexPositions.push_back(glm::vec3(start_x + x_step * x_i, 0, start_z + z_step * z_i));
-      _vertexTexCoords.push_back(glm::vec3(x_i * x_step, 0, z_i * z_step));
-      _vertexNormals.push_back(glm::vec3(0, 1, 0));
-
-      if (x_i > 0 && z_i > 0) {
-        _triangleIndices.push_back(
-          glm::uvec3(_vertexPositions.size() - 2 - rz, _vertexPositions.size() - 1 - rz, _vertexPositions.size() - 2));
-        _triangleIndices.push_back(
-          glm::uvec3(_vertexPositions.size() - 1 - rz, _vertexPositions.size() - 1, _vertexPositions.size() - 2));
-      }
-      // if (x_i == 0 && z_i == 0 || x_i == rx - 1 && z_i == rz - 1  ) {
-      //   std::cout << w << ' ' << start_x + x_step * x_i <<  std::endl;
-      // }
-    }
-  }
-}
-
-void Mesh::addCube(const float h)
-{
-  float a = 0.5 * h;
-  size_t i_cur = _vertexPositions.size();
-
-  _vertexPositions.push_back(glm::vec3(a, a, a));
-  _vertexPositions.push_back(glm::vec3(a, a, -a));
-  _vertexPositions.push_back(glm::vec3(-a, a, -a));
-  _vertexPositions.push_back(glm::vec3(-a, a, a));
-
-  _vertexPositions.push_back(glm::vec3(a, -a, a));
-  _vertexPositions.push_back(glm::vec3(a, -a, -a));
-  _vertexPositions.push_back(glm::vec3(-a, -a, -a));
-  _vertexPositions.push_back(glm::vec3(-a, -a, a));
-
-  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 1, i_cur + 3));
-  _triangleIndices.push_back(glm::uvec3(i_cur + 1, i_cur + 2, i_cur + 3));
-  _vertexNormals.push_back(glm::vec3(0, 1, 0));
-  
-  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 7, i_cur + 4));
-  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 3, i_cur + 7));
-  _vertexNormals.push_back(glm::vec3(0, 0, 1));
-
-  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 4, i_cur + 1));
-  _triangleIndices.push_back(glm::uvec3(i_cur + 4, i_cur + 5, i_cur + 1));
-  _vertexNormals.push_back(glm::vec3(1, 0, 0));
-
-  _triangleIndices.push_back(glm::uvec3(i_cur + 4, i_cur + 7, i_cur + 5));
-  _triangleIndices.push_back(glm::uvec3(i_cur + 5, i_cur + 7, i_cur + 6));
-  _vertexNormals.push_back(glm::vec3(0, -1, 0));
-
-  _triangleIndices.push_back(glm::uvec3(i_cur + 7, i_cur + 3, i_cur + 6));
-  _triangleIndices.push_back(glm::uvec3(i_cur + 3, i_cur + 2, i_cur + 6));
-  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
-
-  _triangleIndices.push_back(glm::uvec3(i_cur + 5, i_cur + 6, i_cur + 1));
-  _triangleIndices.push_back(glm::uvec3(i_cur + 6, i_cur + 2, i_cur + 1));
-  _vertexNormals.push_back(glm::vec3(0, 0, -1));
-}
-
-
 #ifdef SUPPORT_OPENGL_45
 void Mesh::init()
 {
@@ -373,14 +114,143 @@ void Mesh::render()
 {
   glBindVertexArray(_vao);      // Activate the VAO storing geometry data
   glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(_triangleIndices.size()*3), GL_UNSIGNED_INT, 0);
+  fenceStreaming();
+}
+
+void Mesh::renderPoints()
+{
+  glBindVertexArray(_vao);
+  glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(_vertexPositions.size()));
+  fenceStreaming();
+}
+
+void Mesh::enableStreaming(const VertexStream format)
+{
+  if(_streamVbo)
+    return;
+  _streamFormat = format;
+  const GLsizeiptr vertexBytes =
+    format == VertexStream::kCompact ? sizeof(PackedVertex) :
+    format == VertexStream::kPositionsOnly ? sizeof(glm::vec3) : 2*sizeof(glm::vec3);
+  const GLsizeiptr bytes = vertexBytes*_vertexPositions.size();
+  _streamRegion = (bytes + 255)/256*256;
+  const GLsizeiptr total = kStreamFrames*_streamRegion;
+#ifdef SUPPORT_OPENGL_45
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &_streamVbo);
+  glNamedBufferStorage(_streamVbo, total, nullptr, flags);
+  _streamPtr = static_cast<char *>(glMapNamedBufferRange(_streamVbo, 0, total, flags));
+#else
+  glGenBuffers(1, &_streamVbo);
+  glBindBuffer(GL_ARRAY_BUFFER, _streamVbo);
+  glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+#endif
+
+  if(format == VertexStream::kCompact) { // static half-float texture coordinates
+    std::vector<std::uint32_t> uv;
+    packHalfTexCoords(_vertexTexCoords, uv);
+    glDeleteBuffers(1, &_texCoordVbo);
+    glGenBuffers(1, &_texCoordVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, _texCoordVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(std::uint32_t)*uv.size(), uv.data(), GL_STATIC_DRAW);
+    glBindVertexArray(_vao);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(std::uint32_t), 0);
+    glBindVertexArray(0);
+  }
+
+  _streamFrame = kStreamFrames - 1;
+  streamData();
+}
+
+void Mesh::beginStreaming(glm::vec3 *&positions, glm::vec3 *&normals)
+{
+  _streamFrame = (_streamFrame + 1) % kStreamFrames;
+  GLsync &fence = _streamFences[_streamFrame];
+  if(fence) {                   // drawn kStreamFrames uploads ago, so seldom waited for
+    while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(fence);
+    fence = 0;
+  }
+  if(_streamFormat == VertexStream::kCompact) {
+    positions = _vertexPositions.data();
+    normals = _vertexNormals.data();
+  } else {
+    positions = reinterpret_cast<glm::vec3 *>(mapStreamRegion());
+    normals = _streamFormat == VertexStream::kFloat ? positions + _vertexPositions.size() : nullptr;
+  }
+}
+
+void Mesh::endStreaming()
+{
+  const int n = _vertexPositions.size();
+  if(_streamFormat == VertexStream::kCompact) {
+    glm::vec3 lo, hi;
+    boundingBox(_vertexPositions.data(), n, lo, hi);
+    packVertices(_vertexPositions.data(), _vertexNormals.data(), n, lo, hi - lo,
+                 reinterpret_cast<PackedVertex *>(mapStreamRegion()));
+    _positionDecode = glm::translate(glm::mat4(1.f), lo)*glm::scale(glm::mat4(1.f), hi - lo); // of the normalized q/65535
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, _streamVbo);
+#ifndef SUPPORT_OPENGL_45
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+#endif
+
+  const GLintptr offset = _streamFrame*_streamRegion;
+  glBindVertexArray(_vao);
+  if(_streamFormat == VertexStream::kCompact) {
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), reinterpret_cast<const GLvoid *>(offset));
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex),
+                          reinterpret_cast<const GLvoid *>(offset + offsetof(PackedVertex, normal)));
+  } else if(_streamFormat == VertexStream::kFloat) {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), reinterpret_cast<const GLvoid *>(offset));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat),
+                          reinterpret_cast<const GLvoid *>(offset + sizeof(glm::vec3)*n));
+  } else {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), reinterpret_cast<const GLvoid *>(offset));
+    glBindBuffer(GL_ARRAY_BUFFER, _normalVbo);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), 0);
+  }
+  glBindVertexArray(0);
+}
+
+void Mesh::streamData()
+{
+  glm::vec3 *positions, *normals;
+  beginStreaming(positions, normals);
+  if(positions != _vertexPositions.data())
+    std::memcpy(positions, _vertexPositions.data(), sizeof(glm::vec3)*_vertexPositions.size());
+  if(normals && normals != _vertexNormals.data())
+    std::memcpy(normals, _vertexNormals.data(), sizeof(glm::vec3)*_vertexNormals.size());
+  endStreaming();
+}
+
+// The region of the current frame, to be written only
+char *Mesh::mapStreamRegion()
+{
+  const GLintptr offset = _streamFrame*_streamRegion;
+#ifdef SUPPORT_OPENGL_45
+  return _streamPtr + offset;
+#else
+  glBindBuffer(GL_ARRAY_BUFFER, _streamVbo);
+  return static_cast<char *>(glMapBufferRange(
+    GL_ARRAY_BUFFER, offset, _streamRegion, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+#endif
+}
+
+// After the draws of the frame: the region in use is free once they are done
+void Mesh::fenceStreaming()
+{
+  if(!_streamVbo)
+    return;
+  GLsync &fence = _streamFences[_streamFrame];
+  if(fence)
+    glDeleteSync(fence);
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 void Mesh::clear()
 {
-  _vertexPositions.clear();
-  _vertexNormals.clear();
-  _vertexTexCoords.clear();
-  _triangleIndices.clear();
+  MeshData::clear();
   if(_vao) {
     glDeleteVertexArrays(1, &_vao);
     _vao = 0;
@@ -401,43 +271,20 @@ void Mesh::clear()
     glDeleteBuffers(1, &_ibo);
     _ibo = 0;
   }
-}
-
-// Loads an OFF mesh file. See https://en.wikipedia.org/wiki/OFF_(file_format)
-void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr)
-{
-  std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
-  meshPtr->clear();
-  std::ifstream in(filename.c_str());
-  if(!in)
-    throw std::ios_base::failure("[Mesh Loader][loadOFF] Cannot open " + filename);
-  std::string offString;
-  unsigned int sizeV, sizeT, tmp;
-  in >> offString >> sizeV >> sizeT >> tmp;
-  auto &P = meshPtr->vertexPositions();
-  auto &T = meshPtr->triangleIndices();
-  P.resize(sizeV);
-  T.resize(sizeT);
-  size_t tracker = (sizeV + sizeT)/20;
-  std::cout << " > [" << std::flush;
-  for(unsigned int i=0; i<sizeV; ++i) {
-    if(i % tracker == 0)
-      std::cout << "-" << std::flush;
-    in >> P[i][0] >> P[i][1] >> P[i][2];
+  for(GLsync &fence : _streamFences) {
+    if(fence) {
+      glDeleteSync(fence);
+      fence = 0;
+    }
   }
-  int s;
-  for(unsigned int i=0; i<sizeT; ++i) {
-    if((sizeV + i) % tracker == 0)
-      std::cout << "-" << std::flush;
-    in >> s;
-    for(unsigned int j=0; j<3; ++j)
-      in >> T[i][j];
+  _streamFormat = VertexStream::kFloat;
+  _positionDecode = glm::mat4(1.f);
+  if(_streamVbo) {
+#ifdef SUPPORT_OPENGL_45
+    glUnmapNamedBuffer(_streamVbo);
+    _streamPtr = nullptr;
+#endif
+    glDeleteBuffers(1, &_streamVbo);
+    _streamVbo = 0;
   }
-  std::cout << "]" << std::endl;
-  in.close();
-  meshPtr->vertexNormals().resize(P.size(), glm::vec3(0.f, 0.f, 1.f));
-  meshPtr->vertexTexCoords().resize(P.size(), glm::vec2(0.f, 0.f));
-  meshPtr->recomputePerVertexNormals();
-  meshPtr->recomputePerVertexTextureCoordinates();
-  std::cout << " > Mesh <" << filename << "> loaded" <<  std::endl;
 }
@@ -3,59 +3,70 @@
 
 #include <glad/glad.h>
 #include <vector>
-#include <memory>
-#include <string>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
-class Mesh {
-public:
-  virtual ~Mesh();
-
-  const std::vector<glm::vec3> &vertexPositions() const { return _vertexPositions; }
-  std::vector<glm::vec3> &vertexPositions() { return _vertexPositions; }
-
-  const std::vector<glm::vec3> &vertexNormals() const { return _vertexNormals; }
-  std::vector<glm::vec3> &vertexNormals() { return _vertexNormals; }
+#include "MeshData.h"
 
-  const std::vector<glm::vec2> &vertexTexCoords() const { return _vertexTexCoords; }
-  std::vector<glm::vec2> &vertexTexCoords() { return _vertexTexCoords; }
+// Formats of the streamed vertices: float positions and normals, the compact
+// 12-byte vertices of VertexPacking.hpp, or float positions only, the normals
+// being computed on the GPU by GpuNormals
+enum class VertexStream { kFloat, kCompact, kPositionsOnly };
 
-  const std::vector<glm::uvec3> &triangleIndices() const { return _triangleIndices; }
-  std::vector<glm::uvec3> &triangleIndices() { return _triangleIndices; }
-
-  // Compute the parameters of a sphere which bounds the mesh
-  void computeBoundingSphere(glm::vec3 &center, float &radius) const;
-
-  void recomputePerVertexNormals(bool angleBased = false);
-  void recomputePerVertexTextureCoordinates( );
+// A MeshData with the OpenGL buffers to draw it
+class Mesh : public MeshData {
+public:
+  virtual ~Mesh();
 
   void bufferData(const bool vertex, const bool normal) const;
 
   void init();
   void render();
-  void clear();
-
-  void addPlane(const float square_half_side = 1.0f);
-  void addBox(const float w, const float h, const float d);
-  void addCloth(const GLuint rw, const GLuint rh, const float w, const float h);
-  void addCube(const float h);
+  void renderPoints();
+  void clear() override;
+
+  // Streaming of the positions and normals that change every frame, after
+  // init(): a ring of kStreamFrames regions of one buffer, each written once
+  // and drawn until the next one is written. A fence after the draws keeps a
+  // region from being overwritten while the GPU may still read it. The
+  // buffer is mapped persistently with OpenGL 4.5, and per region, without
+  // synchronization, otherwise. The compact format makes the texture
+  // coordinates half floats, and positionDecodeMatrix() is then part of the
+  // model matrix. Without streamed normals, the draws read normalBuffer().
+  static const int kStreamFrames = 3;
+  void enableStreaming(const VertexStream format=VertexStream::kFloat);
+  bool streaming() const { return _streamVbo != 0; }
+  const glm::mat4 &positionDecodeMatrix() const { return _positionDecode; }
+  GLuint streamBuffer() const { return _streamVbo; }
+  GLintptr streamOffset() const { return _streamFrame*_streamRegion; } // of the region drawn
+  GLuint normalBuffer() const { return _normalVbo; }
+  // Pointers to the positions and normals of the next region, only to be
+  // written, until endStreaming() makes the draws use it; in the compact
+  // format, the vertex arrays, packed by endStreaming(), and without
+  // streamed normals, a null normal pointer
+  void beginStreaming(glm::vec3 *&positions, glm::vec3 *&normals);
+  void endStreaming();
+  // Positions and normals of the vertex arrays, through the next region
+  void streamData();
 
 private:
-  std::vector<glm::vec3> _vertexPositions;
-  std::vector<glm::vec3> _vertexNormals;
-  std::vector<glm::vec2> _vertexTexCoords;
-  std::vector<glm::uvec3> _triangleIndices;
-
   GLuint _vao = 0;
   GLuint _posVbo = 0;
   GLuint _normalVbo = 0;
   GLuint _texCoordVbo = 0;
   GLuint _ibo = 0;
-};
 
-// utility: loader
-void loadOFF(const std::string &filename, std::shared_ptr<Mesh> meshPtr);
+  char *mapStreamRegion();
+  void fenceStreaming();
+
+  GLuint _streamVbo = 0;
+  VertexStream _streamFormat = VertexStream::kFloat;
+  glm::mat4 _positionDecode = glm::mat4(1.f);
+  GLsizeiptr _streamRegion = 0; // bytes of a region: the positions, then the normals, or the packed vertices
+  int _streamFrame = 0;         // region written last
+  GLsync _streamFences[kStreamFrames] = {};
+  char *_streamPtr = nullptr;   // persistent mapping
+};
 
 #endif  // MESH_H
@@ -0,0 +1,1070 @@
+#define _USE_MATH_DEFINES
+
+#include "MeshData.h"
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <ios>
+#include <string>
+#include <memory>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "MappedFile.h"
+#include "BinaryCache.h"
+#include "MeshTopology.hpp"
+#include "TextScan.hpp"
+#include "NeighborGrid.hpp"
+#include "VertexCache.hpp"
+
+MeshData::~MeshData()
+{
+}
+
+void MeshData::computeBoundingSphere(glm::vec3 &center, float &radius) const
+{
+  center = glm::vec3(0.0);
+  radius = 0.f;
+  for(const auto &p : _vertexPositions)
+    center += p;
+  center /= _vertexPositions.size();
+  for(const auto &p : _vertexPositions)
+    radius = std::max(radius, distance(center, p));
+}
+
+void MeshData::recomputePerVertexNormals(bool angleBased)
+{
+  // One-shot version for loaded meshes; simulated meshes get theirs from
+  // VertexNormals, which keeps the incidence of the vertices
+  _vertexNormals.assign(_vertexPositions.size(), glm::vec3(0.0, 0.0, 0.0));
+
+  for(unsigned int tIt=0 ; tIt < _triangleIndices.size() ; ++tIt) {
+    glm::uvec3 t = _triangleIndices[tIt];
+    glm::vec3 n_t = glm::cross(
+      _vertexPositions[t[1]] - _vertexPositions[t[0]],
+      _vertexPositions[t[2]] - _vertexPositions[t[0]]);
+    if(!angleBased) {
+      _vertexNormals[t[0]] += n_t;
+      _vertexNormals[t[1]] += n_t;
+      _vertexNormals[t[2]] += n_t;
+      continue;
+    }
+    const float len = glm::length(n_t);
+    if(len <= 0.f)
+      continue;
+    for(int c = 0; c < 3; ++c) {
+      const glm::vec3 e1 = _vertexPositions[t[(c + 1) % 3]] - _vertexPositions[t[c]];
+      const glm::vec3 e2 = _vertexPositions[t[(c + 2) % 3]] - _vertexPositions[t[c]];
+      _vertexNormals[t[c]] += (std::atan2(glm::length(glm::cross(e1, e2)), glm::dot(e1, e2)) / len) * n_t;
+    }
+  }
+  for(unsigned int nIt = 0 ; nIt < _vertexNormals.size() ; ++nIt) {
+    const float len = glm::length(_vertexNormals[nIt]);
+    if(len > 0.f)
+      _vertexNormals[nIt] /= len;
+  }
+}
+
+void MeshData::recomputePerVertexTextureCoordinates()
+{
+  _vertexTexCoords.clear();
+  // Change the following code to compute a proper per-vertex texture coordinates
+  _vertexTexCoords.resize(_vertexPositions.size(), glm::vec2(0.0, 0.0));
+
+  float xMin = FLT_MAX, xMax = FLT_MIN;
+  float yMin = FLT_MAX, yMax = FLT_MIN;
+  for(glm::vec3 &p : _vertexPositions) {
+    xMin = std::min(xMin, p[0]);
+    xMax = std::max(xMax, p[0]);
+    yMin = std::min(yMin, p[1]);
+    yMax = std::max(yMax, p[1]);
+  }
+  for(unsigned int pIt = 0 ; pIt < _vertexTexCoords.size() ; ++pIt) {
+    _vertexTexCoords[pIt] = glm::vec2(
+      (_vertexPositions[pIt][0] - xMin)/(xMax-xMin),
+      (_vertexPositions[pIt][1] - yMin)/(yMax-yMin));
+  }
+}
+
+void MeshData::addPlane(const float square_half_side)
+{
+  _vertexPositions.push_back(glm::vec3(-square_half_side,-square_half_side, 0));
+  _vertexPositions.push_back(glm::vec3(+square_half_side,-square_half_side, 0));
+  _vertexPositions.push_back(glm::vec3(+square_half_side,+square_half_side, 0));
+  _vertexPositions.push_back(glm::vec3(-square_half_side,+square_half_side, 0));
+
+  _vertexTexCoords.push_back(glm::vec2(0.0, 0.0));
+  _vertexTexCoords.push_back(glm::vec2(1.0, 0.0));
+  _vertexTexCoords.push_back(glm::vec2(1.0, 1.0));
+  _vertexTexCoords.push_back(glm::vec2(0.0, 1.0));
+
+  _vertexNormals.push_back(glm::vec3(0,0, 1));
+  _vertexNormals.push_back(glm::vec3(0,0, 1));
+  _vertexNormals.push_back(glm::vec3(0,0, 1));
+  _vertexNormals.push_back(glm::vec3(0,0, 1));
+
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+}
+
+void MeshData::addBox(const float w, const float h, const float d)
+{
+  // back
+  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, -0.5*d));
+  _vertexTexCoords.push_back(glm::vec2(2.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 3.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(2.0, 3.0)*0.25f);
+  _vertexNormals.push_back(glm::vec3(0, 0, -1));
+  _vertexNormals.push_back(glm::vec3(0, 0, -1));
+  _vertexNormals.push_back(glm::vec3(0, 0, -1));
+  _vertexNormals.push_back(glm::vec3(0, 0, -1));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+
+  // front
+  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, +0.5*d));
+  _vertexTexCoords.push_back(glm::vec2(0.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(1.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(1.0, 3.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(0.0, 3.0)*0.25f);
+  _vertexNormals.push_back(glm::vec3(0, 0, 1));
+  _vertexNormals.push_back(glm::vec3(0, 0, 1));
+  _vertexNormals.push_back(glm::vec3(0, 0, 1));
+  _vertexNormals.push_back(glm::vec3(0, 0, 1));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+
+  // bottom
+  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, +0.5*d));
+  _vertexTexCoords.push_back(glm::vec2(2.0, 3.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 3.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 4.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(2.0, 4.0)*0.25f);
+  _vertexNormals.push_back(glm::vec3(0, -1, 0));
+  _vertexNormals.push_back(glm::vec3(0, -1, 0));
+  _vertexNormals.push_back(glm::vec3(0, -1, 0));
+  _vertexNormals.push_back(glm::vec3(0, -1, 0));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+
+  // top
+  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, -0.5*d));
+  _vertexTexCoords.push_back(glm::vec2(2.0, 1.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 1.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(2.0, 2.0)*0.25f);
+  _vertexNormals.push_back(glm::vec3(0, 1, 0));
+  _vertexNormals.push_back(glm::vec3(0, 1, 0));
+  _vertexNormals.push_back(glm::vec3(0, 1, 0));
+  _vertexNormals.push_back(glm::vec3(0, 1, 0));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+
+  // left
+  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, -0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(-0.5*w, +0.5*h, -0.5*d));
+  _vertexTexCoords.push_back(glm::vec2(1.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(2.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(2.0, 3.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(1.0, 3.0)*0.25f);
+  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
+  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
+  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
+  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+
+  // right
+  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, +0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, -0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, -0.5*d));
+  _vertexPositions.push_back(glm::vec3(+0.5*w, +0.5*h, +0.5*d));
+  _vertexTexCoords.push_back(glm::vec2(3.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(4.0, 2.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(4.0, 3.0)*0.25f);
+  _vertexTexCoords.push_back(glm::vec2(3.0, 3.0)*0.25f);
+  _vertexNormals.push_back(glm::vec3(1, 0, 0));
+  _vertexNormals.push_back(glm::vec3(1, 0, 0));
+  _vertexNormals.push_back(glm::vec3(1, 0, 0));
+  _vertexNormals.push_back(glm::vec3(1, 0, 0));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-3, _vertexPositions.size()-2));
+  _triangleIndices.push_back(
+    glm::uvec3(_vertexPositions.size()-4, _vertexPositions.size()-2, _vertexPositions.size()-1));
+}
+
+void MeshData::addCloth(const unsigned int rx, const unsigned int rz, const float w, const float h)
+{
+  // TODO - done: create a rw x rh resolution mesh (with size of w x h)
+
+  float start_x = -0.5 * w;
+  float start_z = -0.5 * h;
+  float x_step = w / (rx - 1);
+  float z_step = h / (rz - 1);
+
+  for (int x_i = 0; x_i < rx; ++x_i) {
+    for (int z_i = 0; z_i < rz; ++z_i) {
+      _vertexPositions.push_back(glm::vec3(start_x + x_step * x_i, 0, start_z + z_step * z_i));
+      _vertexTexCoords.push_back(glm::vec3(x_i * x_step, 0, z_i * z_step));
+      _vertexNormals.push_back(glm::vec3(0, 1, 0));
+
+      if (x_i > 0 && z_i > 0) {
+        _triangleIndices.push_back(
+          glm::uvec3(_vertexPositions.size() - 2 - rz, _vertexPositions.size() - 1 - rz, _vertexPositions.size() - 2));
+        _triangleIndices.push_back(
+          glm::uvec3(_vertexPositions.size() - 1 - rz, _vertexPositions.size() - 1, _vertexPositions.size() - 2));
+      }
+      // if (x_i == 0 && z_i == 0 || x_i == rx - 1 && z_i == rz - 1  ) {
+      //   std::cout << w << ' ' << start_x + x_step * x_i <<  std::endl;
+      // }
+    }
+  }
+}
+
+void MeshData::addCube(const float h)
+{
+  float a = 0.5 * h;
+  size_t i_cur = _vertexPositions.size();
+
+  _vertexPositions.push_back(glm::vec3(a, a, a));
+  _vertexPositions.push_back(glm::vec3(a, a, -a));
+  _vertexPositions.push_back(glm::vec3(-a, a, -a));
+  _vertexPositions.push_back(glm::vec3(-a, a, a));
+
+  _vertexPositions.push_back(glm::vec3(a, -a, a));
+  _vertexPositions.push_back(glm::vec3(a, -a, -a));
+  _vertexPositions.push_back(glm::vec3(-a, -a, -a));
+  _vertexPositions.push_back(glm::vec3(-a, -a, a));
+
+  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 1, i_cur + 3));
+  _triangleIndices.push_back(glm::uvec3(i_cur + 1, i_cur + 2, i_cur + 3));
+  _vertexNormals.push_back(glm::vec3(0, 1, 0));
+  
+  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 7, i_cur + 4));
+  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 3, i_cur + 7));
+  _vertexNormals.push_back(glm::vec3(0, 0, 1));
+
+  _triangleIndices.push_back(glm::uvec3(i_cur, i_cur + 4, i_cur + 1));
+  _triangleIndices.push_back(glm::uvec3(i_cur + 4, i_cur + 5, i_cur + 1));
+  _vertexNormals.push_back(glm::vec3(1, 0, 0));
+
+  _triangleIndices.push_back(glm::uvec3(i_cur + 4, i_cur + 7, i_cur + 5));
+  _triangleIndices.push_back(glm::uvec3(i_cur + 5, i_cur + 7, i_cur + 6));
+  _vertexNormals.push_back(glm::vec3(0, -1, 0));
+
+  _triangleIndices.push_back(glm::uvec3(i_cur + 7, i_cur + 3, i_cur + 6));
+  _triangleIndices.push_back(glm::uvec3(i_cur + 3, i_cur + 2, i_cur + 6));
+  _vertexNormals.push_back(glm::vec3(-1, 0, 0));
+
+  _triangleIndices.push_back(glm::uvec3(i_cur + 5, i_cur + 6, i_cur + 1));
+  _triangleIndices.push_back(glm::uvec3(i_cur + 6, i_cur + 2, i_cur + 1));
+  _vertexNormals.push_back(glm::vec3(0, 0, -1));
+}
+
+void MeshData::clear()
+{
+  _vertexPositions.clear();
+  _vertexNormals.clear();
+  _vertexTexCoords.clear();
+  _triangleIndices.clear();
+}
+
+bool saveMeshCache(const std::string &filename, const std::uint64_t key, const MeshData &mesh, const MeshTopology *topology)
+{
+  CacheWriter writer;
+  writer.add(cacheTag("POS "), mesh.vertexPositions());
+  writer.add(cacheTag("NRM "), mesh.vertexNormals());
+  writer.add(cacheTag("UV  "), mesh.vertexTexCoords());
+  writer.add(cacheTag("TRI "), mesh.triangleIndices());
+  if(topology) {
+    writer.add(cacheTag("EDGE"), topology->edges);
+    writer.add(cacheTag("HNGE"), topology->hinges);
+  }
+  return writer.write(filename, key);
+}
+
+bool loadMeshCache(const std::string &filename, const std::uint64_t key, MeshData &mesh, MeshTopology *topology)
+{
+  CacheReader reader;
+  if(!reader.open(filename, key))
+    return false;
+  mesh.clear();
+  bool ok = reader.read(cacheTag("POS "), mesh.vertexPositions()) &&
+    reader.read(cacheTag("NRM "), mesh.vertexNormals()) &&
+    reader.read(cacheTag("UV  "), mesh.vertexTexCoords()) &&
+    reader.read(cacheTag("TRI "), mesh.triangleIndices());
+  if(ok && topology)
+    ok = reader.read(cacheTag("EDGE"), topology->edges) && reader.read(cacheTag("HNGE"), topology->hinges);
+
+  // a damaged file must not index past the vertices
+  const std::size_t n = mesh.vertexPositions().size();
+  ok = ok && mesh.vertexNormals().size() == n && mesh.vertexTexCoords().size() == n &&
+    std::all_of(mesh.triangleIndices().begin(), mesh.triangleIndices().end(),
+                [n](const glm::uvec3 &t) { return t[0] < n && t[1] < n && t[2] < n; });
+  if(ok && topology) {
+    ok = std::all_of(topology->edges.begin(), topology->edges.end(),
+                     [n](const glm::uvec2 &e) { return e[0] < n && e[1] < n; }) &&
+      std::all_of(topology->hinges.begin(), topology->hinges.end(),
+                  [n](const glm::uvec4 &h) { return h[0] < n && h[1] < n && h[2] < n && h[3] < n; });
+  }
+  if(!ok)
+    mesh.clear();
+  return ok;
+}
+
+namespace {
+
+const std::uint64_t kOffCacheSeed = 2; // to change with the output of loadOFF
+const std::size_t kChunkBytes = 1 << 20; // unit of parallel parsing
+
+void reportMeshOrder(const char *loader, const std::string &filename, const glm::vec2 &acmr)
+{
+  std::cout << "[Mesh Loader][" << loader << "] " << filename
+            << ": vertex cache miss ratio " << acmr[0] << " -> " << acmr[1] << std::endl;
+}
+
+// Chunks [cut[k], cut[k+1]) of about kChunkBytes starting at line beginnings
+std::vector<const char *> cutLines(const char *p, const char *end)
+{
+  const std::size_t numChunks = std::max<std::size_t>(1, (end - p) / kChunkBytes);
+  std::vector<const char *> cut(numChunks + 1);
+  cut[0] = p;
+  cut[numChunks] = end;
+  for(std::size_t k = 1; k < numChunks; ++k) {
+    const char *c = p + (end - p) * k / numChunks;
+    skipLine(c, end);
+    cut[k] = std::max(c, cut[k-1]);
+  }
+  return cut;
+}
+
+// Records, i.e. lines that are neither empty nor comments, in [p, end)
+unsigned int countRecords(const char *p, const char *end)
+{
+  unsigned int n = 0;
+  for(skipEmptyLines(p, end); p < end; skipEmptyLines(p, end)) {
+    ++n;
+    skipLine(p, end);
+  }
+  return n;
+}
+
+// Calls progress with the fraction of the chunks done, from the calling
+// thread only
+void reportChunk(const LoadProgress &progress, unsigned int &done, const unsigned int total)
+{
+  unsigned int d;
+#pragma omp atomic capture
+  d = ++done;
+#ifdef _OPENMP
+  if(omp_get_thread_num() != 0)
+    return;
+#endif
+  if(progress)
+    progress(float(d) / total);
+}
+
+} // namespace
+
+// Loads an OFF mesh file. See https://en.wikipedia.org/wiki/OFF_(file_format)
+// The file is mapped and cut into chunks at line boundaries; the chunks are
+// parsed in parallel, once for the vertices and the triangle counts of the
+// faces, and once more for the faces, which are triangulated as fans.
+void loadOFF(const std::string &filename, std::shared_ptr<MeshData> meshPtr, const LoadProgress &progress)
+{
+  meshPtr->clear();
+  const MappedFile file(filename);
+  const char *p = file.begin(), *end = file.end();
+
+  const std::string cacheName = filename + ".xmesh";
+  const std::uint64_t key = hashBytes(file.begin(), file.size(), kOffCacheSeed);
+  if(loadMeshCache(cacheName, key, *meshPtr)) {
+    if(progress)
+      progress(1.f);
+    return;
+  }
+
+  skipEmptyLines(p, end);
+  const char *magic = p;
+  while(p < end && !isBlank(*p) && *p != '\n') ++p;
+  if(p - magic < 3 || std::string(p - 3, p) != "OFF")
+    throw std::ios_base::failure("[Mesh Loader][loadOFF] Not an OFF file: " + filename);
+  unsigned int sizeV, sizeT, sizeE;
+  skipEmptyLines(p, end);
+  if(!parseUint(p, end, sizeV) || !parseUint(p, end, sizeT) || !parseUint(p, end, sizeE))
+    throw std::ios_base::failure("[Mesh Loader][loadOFF] Bad header in " + filename);
+  skipLine(p, end);
+
+  const std::vector<const char *> cut = cutLines(p, end);
+  const int numChunks = cut.size() - 1;
+
+  std::vector<unsigned int> firstRecord(numChunks + 1, 0), firstTriangle(numChunks + 1, 0);
+#pragma omp parallel for
+  for(int k = 0; k < numChunks; ++k)
+    firstRecord[k] = countRecords(cut[k], cut[k+1]);
+  exclusiveScan(firstRecord);
+  if(firstRecord[numChunks] < sizeV + sizeT)
+    throw std::ios_base::failure("[Mesh Loader][loadOFF] Truncated file " + filename);
+
+  auto &P = meshPtr->vertexPositions();
+  auto &T = meshPtr->triangleIndices();
+  P.resize(sizeV);
+  std::vector<const char *> firstFace(numChunks, nullptr);
+  std::vector<char> ok(numChunks, 1);
+  unsigned int done = 0;
+
+  // vertices, and the triangles of the faces of every chunk
+#pragma omp parallel for schedule(dynamic)
+  for(int k = 0; k < numChunks; ++k) {
+    const char *q = cut[k], *e = cut[k+1];
+    unsigned int r = firstRecord[k], triangles = 0;
+    for(skipEmptyLines(q, e); q < e && r < sizeV + sizeT; skipEmptyLines(q, e), ++r) {
+      if(r < sizeV) {
+        glm::vec3 &x = P[r];
+        ok[k] &= parseFloat(q, e, x[0]) && parseFloat(q, e, x[1]) && parseFloat(q, e, x[2]);
+      } else {
+        if(!firstFace[k])
+          firstFace[k] = q;
+        unsigned int n;
+        ok[k] &= parseUint(q, e, n) && n >= 3;
+        triangles += n >= 3 ? n - 2 : 0;
+      }
+      skipLine(q, e);
+    }
+    firstTriangle[k] = triangles;
+    reportChunk(progress, done, 2*numChunks);
+  }
+  if(std::find(ok.begin(), ok.end(), 0) != ok.end())
+    throw std::ios_base::failure("[Mesh Loader][loadOFF] Bad vertex or face in " + filename);
+  exclusiveScan(firstTriangle);
+  T.resize(firstTriangle[numChunks]);
+
+  // faces
+#pragma omp parallel for schedule(dynamic)
+  for(int k = 0; k < numChunks; ++k) {
+    if(firstFace[k]) {
+      const char *q = firstFace[k], *e = cut[k+1];
+      unsigned int t = firstTriangle[k];
+      for(skipEmptyLines(q, e); q < e && t < firstTriangle[k+1]; skipEmptyLines(q, e)) {
+        unsigned int n, v[3];
+        parseUint(q, e, n);
+        ok[k] &= parseUint(q, e, v[0]) && parseUint(q, e, v[1]);
+        for(unsigned int j = 2; j < n && ok[k]; ++j) {
+          ok[k] &= parseUint(q, e, v[2]) && v[0] < sizeV && v[1] < sizeV && v[2] < sizeV;
+          T[t++] = glm::uvec3(v[0], v[1], v[2]);
+          v[1] = v[2];
+        }
+        skipLine(q, e);
+      }
+    }
+    reportChunk(progress, done, 2*numChunks);
+  }
+  if(std::find(ok.begin(), ok.end(), 0) != ok.end())
+    throw std::ios_base::failure("[Mesh Loader][loadOFF] Bad face in " + filename);
+
+  meshPtr->vertexNormals().resize(P.size(), glm::vec3(0.f, 0.f, 1.f));
+  meshPtr->vertexTexCoords().resize(P.size(), glm::vec2(0.f, 0.f));
+  meshPtr->recomputePerVertexNormals();
+  meshPtr->recomputePerVertexTextureCoordinates();
+  reportMeshOrder("loadOFF", filename, optimizeMeshOrder(*meshPtr));
+  saveMeshCache(cacheName, key, *meshPtr); // best effort, the directory may be read-only
+  if(progress)
+    progress(1.f);
+}
+
+namespace {
+
+template <typename T>
+void permuteVertices(std::vector<T> &a, const std::vector<unsigned int> &newIndex)
+{
+  if(a.size() != newIndex.size())
+    return;
+  std::vector<T> b(a.size());
+  for(std::size_t i = 0; i < a.size(); ++i)
+    b[newIndex[i]] = a[i];
+  a.swap(b);
+}
+
+}  // namespace
+
+glm::vec2 optimizeMeshOrder(MeshData &mesh)
+{
+  std::vector<glm::uvec3> &T = mesh.triangleIndices();
+  const unsigned int n = mesh.vertexPositions().size();
+  const float before = vertexCacheMissRatio(T, n);
+  optimizeVertexCache(T, n);
+  std::vector<unsigned int> newIndex;
+  optimizeVertexFetch(T, n, newIndex);
+  permuteVertices(mesh.vertexPositions(), newIndex);
+  permuteVertices(mesh.vertexNormals(), newIndex);
+  permuteVertices(mesh.vertexTexCoords(), newIndex);
+  return glm::vec2(before, vertexCacheMissRatio(T, n));
+}
+
+unsigned int weldPositions(const std::vector<glm::vec3> &x, const float tolerance, std::vector<unsigned int> &weld)
+{
+  const int n = x.size();
+  weld.resize(n);
+  if(n == 0)
+    return 0;
+
+  // smallest index within the tolerance of every position, itself included;
+  // cells twice the tolerance keep the search to 8 cells. Cells are at least
+  // 1e-6 of the largest coordinate, so that the cell coordinates fit an int
+  // even for a zero tolerance or a mesh far from the origin.
+  float extent = 0.f;
+  for(const glm::vec3 &p : x)
+    extent = std::max(extent, std::max(std::abs(p[0]), std::max(std::abs(p[1]), std::abs(p[2]))));
+  NeighborGrid grid;
+  const float tol = std::max(tolerance, extent > 0.f ? 1e-6f*extent : 1.f);
+  grid.build(x, 2.f*tol);
+  const float tol2 = tolerance*tolerance;
+#pragma omp parallel for
+  for(int i = 0; i < n; ++i) {
+    unsigned int r = i;
+    grid.forEachInBox(x[i], tol, [&](unsigned int j) {
+      const glm::vec3 d = x[i] - x[j];
+      if(j < r && glm::dot(d, d) <= tol2)
+        r = j;
+    });
+    weld[i] = r;
+  }
+
+  // chains resolved in increasing order, then representatives numbered
+  unsigned int count = 0;
+  for(int i = 0; i < n; ++i) {
+    if(weld[i] == unsigned(i))
+      weld[i] = count++;
+    else
+      weld[i] = weld[weld[i]];
+  }
+  return count;
+}
+
+namespace {
+
+const float kWeldTolerance = 1e-6f; // relative to the bounding box diagonal
+
+float boundingDiagonal(const std::vector<glm::vec3> &x)
+{
+  if(x.empty())
+    return 0.f;
+  glm::vec3 lo = x[0], hi = x[0];
+  for(const auto &p : x) {
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+  return glm::length(hi - lo);
+}
+
+// Normals, missing texture coordinates and the welding common to the importers
+void finishImport(
+  const char *loader, const std::string &filename, MeshData &mesh, const bool hasTexCoords, std::vector<unsigned int> *weld)
+{
+  mesh.recomputePerVertexNormals();
+  if(!hasTexCoords)
+    mesh.recomputePerVertexTextureCoordinates();
+  reportMeshOrder(loader, filename, optimizeMeshOrder(mesh)); // before welding, which numbers in vertex order
+  if(weld)
+    weldPositions(mesh.vertexPositions(), kWeldTolerance*boundingDiagonal(mesh.vertexPositions()), *weld);
+}
+
+const unsigned int kNoIndex = ~0u;
+
+// One "v", "v/t", "v//n" or "v/t/n" reference of an OBJ face, resolved to
+// zero-based indices; relative indices count back from the counts so far,
+// (numV, numT), others must be below the totals
+bool parseObjCorner(
+  const char *&p, const char *end, const unsigned int numV, const unsigned int numT,
+  const glm::uvec2 &total, glm::uvec2 &c)
+{
+  int idx[2] = {0, 0};
+  for(int a = 0; a < 3; ++a) {
+    skipBlanks(p, end);
+    const bool negative = p < end && *p == '-';
+    if(negative) ++p;
+    unsigned int u = 0;
+    const bool any = p < end && unsigned(*p - '0') < 10u;
+    if(any && !parseUint(p, end, u))
+      return false;
+    if(a < 2)
+      idx[a] = any ? (negative ? -int(u) : int(u)) : 0;
+    if(p == end || *p != '/')
+      break;
+    ++p;
+  }
+  const long long v = idx[0] < 0 ? (long long)numV + idx[0] : (long long)idx[0] - 1;
+  const long long t = idx[1] < 0 ? (long long)numT + idx[1] : (long long)idx[1] - 1;
+  if(idx[0] == 0 || v < 0 || v >= total[0] || (idx[1] != 0 && (t < 0 || t >= total[1])))
+    return false;
+  c = glm::uvec2(v, idx[1] == 0 ? kNoIndex : t);
+  return true;
+}
+
+// Number of references on the rest of a face line
+unsigned int countObjCorners(const char *p, const char *end)
+{
+  unsigned int n = 0;
+  for(;;) {
+    skipBlanks(p, end);
+    if(atLineEnd(p, end))
+      return n;
+    ++n;
+    while(p < end && !isBlank(*p) && *p != '\n') ++p;
+  }
+}
+
+struct ObjCounts {
+  unsigned int v = 0, vt = 0, tri = 0;
+};
+
+// Kind of an OBJ line: 'v', 't' (vt), 'f' or 0 for anything else; p is moved
+// past the keyword
+char objKeyword(const char *&p, const char *end)
+{
+  skipBlanks(p, end);
+  if(end - p >= 2 && p[0] == 'v' && isBlank(p[1])) { p += 2; return 'v'; }
+  if(end - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) { p += 3; return 't'; }
+  if(end - p >= 2 && p[0] == 'f' && isBlank(p[1])) { p += 2; return 'f'; }
+  return 0;
+}
+
+} // namespace
+
+// Two parallel passes over the chunks of the mapped file, as loadOFF: counts,
+// then the positions, texture coordinates and face corners, so that relative
+// indices resolve. A vertex of the mesh is a distinct pair of position and
+// texture coordinate, numbered in the order of the positions.
+void loadOBJ(const std::string &filename, std::shared_ptr<MeshData> meshPtr, std::vector<unsigned int> *weld, const LoadProgress &progress)
+{
+  meshPtr->clear();
+  const MappedFile file(filename);
+  const std::vector<const char *> cut = cutLines(file.begin(), file.end());
+  const int numChunks = cut.size() - 1;
+  unsigned int done = 0;
+
+  std::vector<ObjCounts> counts(numChunks + 1);
+#pragma omp parallel for schedule(dynamic)
+  for(int k = 0; k < numChunks; ++k) {
+    ObjCounts c;
+    for(const char *q = cut[k], *e = cut[k+1]; q < e; skipLine(q, e)) {
+      switch(objKeyword(q, e)) {
+      case 'v': ++c.v; break;
+      case 't': ++c.vt; break;
+      case 'f': {
+        const unsigned int n = countObjCorners(q, e);
+        c.tri += n >= 3 ? n - 2 : 0;
+        break;
+      }
+      }
+    }
+    counts[k] = c;
+    reportChunk(progress, done, 3*numChunks);
+  }
+  std::vector<unsigned int> firstV(numChunks + 1), firstT(numChunks + 1), firstTri(numChunks + 1);
+  for(int k = 0; k <= numChunks; ++k) {
+    firstV[k] = counts[k].v;
+    firstT[k] = counts[k].vt;
+    firstTri[k] = counts[k].tri;
+  }
+  exclusiveScan(firstV);
+  exclusiveScan(firstT);
+  exclusiveScan(firstTri);
+
+  std::vector<glm::vec3> V(firstV[numChunks]);
+  std::vector<glm::vec2> VT(firstT[numChunks]);
+  std::vector<glm::uvec2> corners(3*firstTri[numChunks]);
+  const glm::uvec2 total(V.size(), VT.size());
+  std::vector<char> ok(numChunks, 1);
+#pragma omp parallel for schedule(dynamic)
+  for(int k = 0; k < numChunks; ++k) {
+    unsigned int v = firstV[k], t = firstT[k], c = 3*firstTri[k];
+    for(const char *q = cut[k], *e = cut[k+1]; q < e && ok[k]; skipLine(q, e)) {
+      switch(objKeyword(q, e)) {
+      case 'v':
+        ok[k] = parseFloat(q, e, V[v][0]) && parseFloat(q, e, V[v][1]) && parseFloat(q, e, V[v][2]);
+        ++v;
+        break;
+      case 't':
+        ok[k] = parseFloat(q, e, VT[t][0]);
+        VT[t][1] = 0.f;         // the second coordinate is optional
+        parseFloat(q, e, VT[t][1]);
+        ++t;
+        break;
+      case 'f': {
+        const unsigned int n = countObjCorners(q, e);
+        if(n < 3)
+          break;
+        glm::uvec2 first, prev, cur;
+        ok[k] = parseObjCorner(q, e, v, t, total, first) && parseObjCorner(q, e, v, t, total, prev);
+        for(unsigned int j = 2; j < n && ok[k]; ++j) {
+          ok[k] = parseObjCorner(q, e, v, t, total, cur);
+          corners[c++] = first;
+          corners[c++] = prev;
+          corners[c++] = cur;
+          prev = cur;
+        }
+        break;
+      }
+      }
+    }
+    reportChunk(progress, done, 3*numChunks);
+  }
+  if(std::find(ok.begin(), ok.end(), 0) != ok.end())
+    throw std::ios_base::failure("[Mesh Loader][loadOBJ] Bad vertex or face in " + filename);
+
+  // corners bucketed by position, then the distinct texture coordinates of
+  // every position numbered in a scan
+  const int numV = V.size(), numC = corners.size();
+  std::vector<unsigned int> start(numV + 1, 0), bucket(numC), local(numC), distinct(numV + 1, 0);
+  for(const auto &c : corners)
+    ++start[c[0]];
+  exclusiveScan(start);
+  {
+    std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+    for(int c = 0; c < numC; ++c)
+      bucket[fill[corners[c][0]]++] = c;
+  }
+#pragma omp parallel for
+  for(int i = 0; i < numV; ++i) {
+    unsigned int d = 0;
+    for(unsigned int a = start[i]; a < start[i+1]; ++a) {
+      unsigned int b = start[i];
+      while(b < a && corners[bucket[b]][1] != corners[bucket[a]][1]) ++b;
+      local[bucket[a]] = b < a ? local[bucket[b]] : d++;
+    }
+    distinct[i] = d;
+  }
+  exclusiveScan(distinct);
+
+  auto &P = meshPtr->vertexPositions();
+  auto &UV = meshPtr->vertexTexCoords();
+  auto &T = meshPtr->triangleIndices();
+  P.resize(distinct[numV]);
+  UV.resize(distinct[numV]);
+  T.resize(numC / 3);
+#pragma omp parallel for
+  for(int i = 0; i < numV; ++i) {
+    for(unsigned int a = start[i]; a < start[i+1]; ++a) {
+      const unsigned int c = bucket[a], r = distinct[i] + local[c];
+      P[r] = V[i];
+      UV[r] = corners[c][1] == kNoIndex ? glm::vec2(0.f) : VT[corners[c][1]];
+      T[c / 3][c % 3] = r;
+    }
+  }
+  finishImport("loadOBJ", filename, *meshPtr, !VT.empty(), weld);
+  reportChunk(progress, done, 3*numChunks);
+  if(progress)
+    progress(1.f);
+}
+
+namespace {
+
+struct PlyProperty {
+  std::string name;
+  int type = 0;                 // size in bytes of the value, negative for a signed integer, 0 unknown
+  bool isFloat = false;
+  bool isList = false;
+  int countType = 0;            // of the list length
+};
+
+struct PlyElement {
+  std::string name;
+  std::size_t count = 0;
+  std::vector<PlyProperty> properties;
+  // byte offset of each property in a record, -1 after the first list
+  std::vector<long> offsets;
+  long stride = 0;              // record size when there is no list, else -1
+};
+
+// Size of a PLY scalar type, negative for signed integers, 0 if unknown
+int plyType(const std::string &t, bool &isFloat)
+{
+  isFloat = t == "float" || t == "float32" || t == "double" || t == "float64";
+  if(t == "char" || t == "int8") return -1;
+  if(t == "uchar" || t == "uint8") return 1;
+  if(t == "short" || t == "int16") return -2;
+  if(t == "ushort" || t == "uint16") return 2;
+  if(t == "int" || t == "int32") return -4;
+  if(t == "uint" || t == "uint32" || t == "float" || t == "float32") return 4;
+  if(t == "double" || t == "float64") return 8;
+  return 0;
+}
+
+double plyRead(const char *p, const int type, const bool isFloat, const bool swap)
+{
+  unsigned char b[8];
+  const int size = std::abs(type);
+  for(int i = 0; i < size; ++i)
+    b[i] = p[swap ? size - 1 - i : i];
+  switch(type) {
+  case -1: { std::int8_t v; std::memcpy(&v, b, 1); return v; }
+  case 1: return b[0];
+  case -2: { std::int16_t v; std::memcpy(&v, b, 2); return v; }
+  case 2: { std::uint16_t v; std::memcpy(&v, b, 2); return v; }
+  case -4: { std::int32_t v; std::memcpy(&v, b, 4); return v; }
+  case 4:
+    if(isFloat) { float v; std::memcpy(&v, b, 4); return v; }
+    else { std::uint32_t v; std::memcpy(&v, b, 4); return v; }
+  case 8: { double v; std::memcpy(&v, b, 8); return v; }
+  }
+  return 0.0;
+}
+
+int plyFind(const PlyElement &e, const char *name)
+{
+  for(std::size_t i = 0; i < e.properties.size(); ++i)
+    if(e.properties[i].name == name)
+      return i;
+  return -1;
+}
+
+// Walks one record of an element with lists; false past end
+bool plySkipRecord(const PlyElement &e, const char *&p, const char *end, const bool swap)
+{
+  for(const auto &prop : e.properties) {
+    if(prop.isList) {
+      if(p + std::abs(prop.countType) > end) return false;
+      const std::size_t n = plyRead(p, prop.countType, false, swap);
+      p += std::abs(prop.countType) + n*std::abs(prop.type);
+    } else {
+      p += std::abs(prop.type);
+    }
+  }
+  return p <= end;
+}
+
+} // namespace
+
+// Binary PLY, in either byte order. Vertex records have a fixed size and are
+// decoded in parallel; so are the faces when they are all triangles, which
+// is checked first, otherwise they are walked in order. Elements other than
+// "vertex" and "face" are skipped.
+void loadPLY(const std::string &filename, std::shared_ptr<MeshData> meshPtr, std::vector<unsigned int> *weld, const LoadProgress &progress)
+{
+  meshPtr->clear();
+  const MappedFile file(filename);
+  const char *p = file.begin(), *end = file.end();
+  const std::string err = "[Mesh Loader][loadPLY] ";
+
+  // header
+  std::vector<PlyElement> elements;
+  bool swap = false, binary = false;
+  const std::uint16_t one = 1;
+  const bool littleEndian = *reinterpret_cast<const unsigned char *>(&one) == 1;
+  for(bool first = true; ; first = false) {
+    if(p == end)
+      throw std::ios_base::failure(err + "Truncated header in " + filename);
+    const char *lineEnd = p;
+    skipLine(lineEnd, end);
+    std::istringstream line(std::string(p, lineEnd));
+    p = lineEnd;
+    std::string word;
+    line >> word;
+    if(first) {
+      if(word != "ply")
+        throw std::ios_base::failure(err + "Not a PLY file: " + filename);
+    } else if(word == "format") {
+      std::string format;
+      line >> format;
+      binary = format != "ascii";
+      if(format == "binary_little_endian") swap = !littleEndian;
+      else if(format == "binary_big_endian") swap = littleEndian;
+      else binary = false;
+    } else if(word == "element") {
+      elements.push_back(PlyElement());
+      line >> elements.back().name >> elements.back().count;
+    } else if(word == "property" && !elements.empty()) {
+      PlyProperty prop;
+      std::string type;
+      line >> type;
+      if(type == "list") {
+        std::string countType;
+        line >> countType >> type;
+        prop.isList = true;
+        bool f;
+        prop.countType = plyType(countType, f);
+        if(f) prop.countType = 0;
+      }
+      prop.type = plyType(type, prop.isFloat);
+      line >> prop.name;
+      if(prop.type == 0 || (prop.isList && prop.countType == 0))
+        throw std::ios_base::failure(err + "Unknown property type in " + filename);
+      elements.back().properties.push_back(prop);
+    } else if(word == "end_header") {
+      break;
+    }
+  }
+  if(!binary)
+    throw std::ios_base::failure(err + "Only binary PLY files are supported: " + filename);
+  for(auto &e : elements) {
+    long offset = 0;
+    for(const auto &prop : e.properties) {
+      e.offsets.push_back(offset);
+      offset = prop.isList || offset < 0 ? -1 : offset + std::abs(prop.type);
+    }
+    e.stride = offset;
+  }
+
+  auto &P = meshPtr->vertexPositions();
+  auto &UV = meshPtr->vertexTexCoords();
+  auto &T = meshPtr->triangleIndices();
+  bool hasTexCoords = false;
+  unsigned int done = 0;
+  for(const auto &e : elements) {
+    if(e.name == "vertex") {
+      const int ix = plyFind(e, "x"), iy = plyFind(e, "y"), iz = plyFind(e, "z");
+      int iu = plyFind(e, "u"), iv = plyFind(e, "v");
+      if(iu < 0 || iv < 0) { iu = plyFind(e, "s"); iv = plyFind(e, "t"); }
+      if(iu < 0 || iv < 0) { iu = plyFind(e, "texture_u"); iv = plyFind(e, "texture_v"); }
+      hasTexCoords = iu >= 0 && iv >= 0;
+      if(e.stride < 0 || ix < 0 || iy < 0 || iz < 0)
+        throw std::ios_base::failure(err + "Unsupported vertex element in " + filename);
+      if(std::size_t(end - p) / e.stride < e.count)
+        throw std::ios_base::failure(err + "Truncated vertices in " + filename);
+      const int n = e.count;
+      P.resize(n);
+      UV.assign(n, glm::vec2(0.f));
+      const int ids[5] = {ix, iy, iz, iu, iv};
+#pragma omp parallel for
+      for(int i = 0; i < n; ++i) {
+        const char *r = p + std::size_t(i)*e.stride;
+        float x[5];
+        for(int a = 0; a < (hasTexCoords ? 5 : 3); ++a) {
+          const PlyProperty &prop = e.properties[ids[a]];
+          x[a] = plyRead(r + e.offsets[ids[a]], prop.type, prop.isFloat, swap);
+        }
+        P[i] = glm::vec3(x[0], x[1], x[2]);
+        if(hasTexCoords)
+          UV[i] = glm::vec2(x[3], x[4]);
+      }
+      p += e.count*e.stride;
+      reportChunk(progress, done, 3);
+    } else if(e.name == "face") {
+      int il = plyFind(e, "vertex_indices");
+      if(il < 0) il = plyFind(e, "vertex_index");
+      if(il < 0 || !e.properties[il].isList)
+        throw std::ios_base::failure(err + "Unsupported face element in " + filename);
+      for(int a = 0; a < il; ++a)
+        if(e.properties[a].isList)
+          throw std::ios_base::failure(err + "Unsupported face element in " + filename);
+      const PlyProperty &list = e.properties[il];
+      const int cs = std::abs(list.countType), is = std::abs(list.type);
+      const unsigned int numV = P.size();
+      bool ok = true;
+
+      // all triangles: a fixed stride, with the list at the same offset
+      long before = 0, after = 0;
+      bool fixed = true;
+      for(std::size_t a = 0; a < e.properties.size(); ++a) {
+        if(int(a) != il && e.properties[a].isList) fixed = false;
+        (int(a) < il ? before : after) += int(a) == il ? 0 : std::abs(e.properties[a].type);
+      }
+      const long stride = before + cs + 3*is + after;
+      const int n = e.count;
+      fixed = fixed && std::size_t(end - p) / stride >= e.count;
+      if(fixed) {
+#pragma omp parallel for reduction(&&:fixed)
+        for(int f = 0; f < n; ++f)
+          fixed = fixed && plyRead(p + std::size_t(f)*stride + before, list.countType, false, swap) == 3.0;
+      }
+      if(fixed) {
+        T.resize(n);
+#pragma omp parallel for reduction(&&:ok)
+        for(int f = 0; f < n; ++f) {
+          const char *r = p + std::size_t(f)*stride + before + cs;
+          for(int a = 0; a < 3; ++a) {
+            const double v = plyRead(r + a*is, list.type, false, swap);
+            ok = ok && v >= 0 && v < numV;
+            T[f][a] = v;
+          }
+        }
+        p += std::size_t(n)*stride;
+      } else {
+        for(int f = 0; f < n && ok; ++f) {
+          const char *r = p;
+          if(!plySkipRecord(e, p, end, swap)) {
+            ok = false;
+            break;
+          }
+          r += before;
+          const unsigned int count = plyRead(r, list.countType, false, swap);
+          r += cs;
+          unsigned int v[3];
+          for(unsigned int j = 0; j < count && ok; ++j) {
+            const double x = plyRead(r + j*is, list.type, false, swap);
+            ok = x >= 0 && x < numV;
+            v[std::min(j, 2u)] = x;
+            if(j >= 2) {
+              T.push_back(glm::uvec3(v[0], v[1], v[2]));
+              v[1] = v[2];
+            }
+          }
+        }
+      }
+      if(!ok)
+        throw std::ios_base::failure(err + "Bad face in " + filename);
+      reportChunk(progress, done, 3);
+    } else {
+      for(std::size_t i = 0; i < e.count; ++i)
+        if(!plySkipRecord(e, p, end, swap))
+          throw std::ios_base::failure(err + "Truncated element " + e.name + " in " + filename);
+    }
+  }
+  if(P.empty())
+    throw std::ios_base::failure(err + "No vertex in " + filename);
+  finishImport("loadPLY", filename, *meshPtr, hasTexCoords, weld);
+  reportChunk(progress, done, 3);
+  if(progress)
+    progress(1.f);
+}
+
+bool saveOBJ(const std::string &filename, const MeshData &mesh)
+{
+  std::FILE *out = std::fopen(filename.c_str(), "w");
+  if(!out)
+    return false;
+  bool ok = true;
+  for(const glm::vec3 &p : mesh.vertexPositions())
+    ok = ok && std::fprintf(out, "v %.7g %.7g %.7g\n", p[0], p[1], p[2]) > 0;
+  for(const glm::uvec3 &t : mesh.triangleIndices())
+    ok = ok && std::fprintf(out, "f %u %u %u\n", t[0] + 1, t[1] + 1, t[2] + 1) > 0;
+  return std::fclose(out) == 0 && ok;
+}
@@ -0,0 +1,86 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+// Vertex arrays and triangles of a mesh, without OpenGL: what the solver,
+// the loaders and xpbd_sim work on. Mesh adds the buffers to draw it.
+class MeshData {
+public:
+  virtual ~MeshData();
+
+  const std::vector<glm::vec3> &vertexPositions() const { return _vertexPositions; }
+  std::vector<glm::vec3> &vertexPositions() { return _vertexPositions; }
+
+  const std::vector<glm::vec3> &vertexNormals() const { return _vertexNormals; }
+  std::vector<glm::vec3> &vertexNormals() { return _vertexNormals; }
+
+  const std::vector<glm::vec2> &vertexTexCoords() const { return _vertexTexCoords; }
+  std::vector<glm::vec2> &vertexTexCoords() { return _vertexTexCoords; }
+
+  const std::vector<glm::uvec3> &triangleIndices() const { return _triangleIndices; }
+  std::vector<glm::uvec3> &triangleIndices() { return _triangleIndices; }
+
+  // Compute the parameters of a sphere which bounds the mesh
+  void computeBoundingSphere(glm::vec3 &center, float &radius) const;
+
+  void recomputePerVertexNormals(bool angleBased = false);
+  void recomputePerVertexTextureCoordinates( );
+
+  virtual void clear();
+
+  void addPlane(const float square_half_side = 1.0f);
+  void addBox(const float w, const float h, const float d);
+  void addCloth(const unsigned int rw, const unsigned int rh, const float w, const float h);
+  void addCube(const float h);
+
+protected:
+  std::vector<glm::vec3> _vertexPositions;
+  std::vector<glm::vec3> _vertexNormals;
+  std::vector<glm::vec2> _vertexTexCoords;
+  std::vector<glm::uvec3> _triangleIndices;
+};
+
+struct MeshTopology;
+
+// utility: binary cache of a mesh (see BinaryCache.h), with its topology when
+// given; the key identifies the content the mesh was made from
+bool saveMeshCache(const std::string &filename, const std::uint64_t key, const MeshData &mesh, const MeshTopology *topology=nullptr);
+bool loadMeshCache(const std::string &filename, const std::uint64_t key, MeshData &mesh, MeshTopology *topology=nullptr);
+
+// utility: loader, reporting the fraction of the file parsed to progress
+// The parsed mesh is cached in <filename>.xmesh, keyed by the content of the
+// file; an unchanged file is then read from the cache without parsing.
+typedef std::function<void(float)> LoadProgress;
+void loadOFF(const std::string &filename, std::shared_ptr<MeshData> meshPtr, const LoadProgress &progress=LoadProgress());
+
+// utility: importers. Polygons are triangulated as fans, and vertices are
+// split where the texture coordinates are discontinuous, so that the mesh
+// renders as authored. weld, if given, receives for every vertex the index
+// of its position once the positions closer than a tolerance relative to the
+// mesh size are merged; PbdSolver::initSim() simulates the welded vertices.
+void loadOBJ(const std::string &filename, std::shared_ptr<MeshData> meshPtr, std::vector<unsigned int> *weld=nullptr, const LoadProgress &progress=LoadProgress());
+void loadPLY(const std::string &filename, std::shared_ptr<MeshData> meshPtr, std::vector<unsigned int> *weld=nullptr, const LoadProgress &progress=LoadProgress());
+
+// utility: exporter of the positions and triangles, e.g. for the frames of
+// xpbd_sim; a mesh without triangles is written as points. False if the file
+// cannot be written.
+bool saveOBJ(const std::string &filename, const MeshData &mesh);
+
+// utility: reorders the triangles for the post-transform vertex cache, then
+// the vertices in the order the triangles use them (see VertexCache.hpp);
+// returns the average cache miss ratio before and after. The loaders call it
+// before welding, so that the simulated vertices come in the same order.
+glm::vec2 optimizeMeshOrder(MeshData &mesh);
+
+// Index of every position among the distinct ones, positions within the
+// tolerance of each other being the same; returns the number of distinct ones
+unsigned int weldPositions(const std::vector<glm::vec3> &x, const float tolerance, std::vector<unsigned int> &weld);
+
+#endif  // MESH_DATA_H
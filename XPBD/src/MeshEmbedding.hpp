@@ -0,0 +1,154 @@
+// ----------------------------------------------------------------------------
+// MeshEmbedding.hpp
+//
+// Description: Embedding of a fine render mesh on a coarse simulated one, so
+//              that the solver runs on the coarse mesh and the fine one
+//              follows it
+// ----------------------------------------------------------------------------
+
+#ifndef _MESHEMBEDDING_HPP_
+#define _MESHEMBEDDING_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "NeighborGrid.hpp"
+
+// build() binds every fine vertex, once and at rest, to the closest point of
+// the coarse surface: the three vertices of its triangle, the barycentric
+// coordinates of the point and the signed distance along the interpolated
+// normal there. apply() is then a parallel pass over the fine vertices that
+// reads a few coarse vertices each and writes the fine positions and normals
+// straight to the given buffers.
+class MeshEmbedding {
+public:
+  tUint size() const { return _vertices.size(); }
+
+  void build(
+    const std::vector<glm::vec3> &coarse_x, const std::vector<glm::vec3> &coarse_n,
+    const std::vector<glm::uvec3> &coarse_triangles, const std::vector<glm::vec3> &fine_x)
+  {
+    const int nt = coarse_triangles.size(), nf = fine_x.size();
+    _vertices.resize(nf);
+    _weights.resize(nf);
+    if(nt == 0)
+      return;
+
+    // triangles bucketed by centroid; the closest triangle of a point within
+    // `reach` of the surface has its centroid in the 27 cells around it
+    std::vector<glm::vec3> centroids(nt);
+    tReal radius = 0.f;
+    for(int t = 0; t < nt; ++t) {
+      const glm::uvec3 &tri = coarse_triangles[t];
+      centroids[t] = (coarse_x[tri[0]] + coarse_x[tri[1]] + coarse_x[tri[2]]) / 3.f;
+      for(int a = 0; a < 3; ++a)
+        radius = std::max(radius, glm::length(coarse_x[tri[a]] - centroids[t]));
+    }
+    const tReal cell = 2.f*std::max(radius, 1e-6f), reach = cell - radius;
+    NeighborGrid grid;
+    grid.build(centroids, cell);
+
+#pragma omp parallel for
+    for(int i = 0; i < nf; ++i) {
+      const glm::vec3 &p = fine_x[i];
+      tReal best = std::numeric_limits<tReal>::max();
+      int best_t = 0;
+      glm::vec3 best_b(1.f, 0.f, 0.f);
+      const auto visit = [&](const tUint t) {
+        const glm::uvec3 &tri = coarse_triangles[t];
+        const glm::vec3 b = closestPoint(p, coarse_x[tri[0]], coarse_x[tri[1]], coarse_x[tri[2]]);
+        const glm::vec3 d = p - (b[0]*coarse_x[tri[0]] + b[1]*coarse_x[tri[1]] + b[2]*coarse_x[tri[2]]);
+        const tReal dist2 = glm::dot(d, d);
+        if(dist2 < best) {
+          best = dist2;
+          best_t = t;
+          best_b = b;
+        }
+      };
+      grid.forEachNeighbor(p, visit);
+      if(best > reach*reach)    // far from the surface: the grid may miss it
+        for(int t = 0; t < nt; ++t) visit(t);
+
+      const glm::uvec3 &tri = coarse_triangles[best_t];
+      const glm::vec3 q = best_b[0]*coarse_x[tri[0]] + best_b[1]*coarse_x[tri[1]] + best_b[2]*coarse_x[tri[2]];
+      const glm::vec3 n = unit(best_b[0]*coarse_n[tri[0]] + best_b[1]*coarse_n[tri[1]] + best_b[2]*coarse_n[tri[2]]);
+      _vertices[i] = tri;
+      _weights[i] = glm::vec4(best_b, glm::dot(p - q, n));
+    }
+  }
+
+  // Positions and unit normals of the fine vertices from the coarse ones;
+  // fine_x and fine_n hold size() vertices, as a mapped vertex buffer, and
+  // fine_n may be null
+  void apply(
+    const std::vector<glm::vec3> &coarse_x, const std::vector<glm::vec3> &coarse_n,
+    glm::vec3 *fine_x, glm::vec3 *fine_n) const
+  {
+    const int nf = _vertices.size();
+#pragma omp parallel for
+    for(int i = 0; i < nf; ++i) {
+      const glm::uvec3 &v = _vertices[i];
+      const glm::vec4 &w = _weights[i];
+      const glm::vec3 n = unit(w[0]*coarse_n[v[0]] + w[1]*coarse_n[v[1]] + w[2]*coarse_n[v[2]]);
+      fine_x[i] = w[0]*coarse_x[v[0]] + w[1]*coarse_x[v[1]] + w[2]*coarse_x[v[2]] + w[3]*n;
+      if(fine_n) fine_n[i] = n;
+    }
+  }
+
+private:
+  static glm::vec3 unit(const glm::vec3 &n)
+  {
+    const tReal len2 = glm::dot(n, n);
+    return len2 > 0.f ? n/std::sqrt(len2) : n;
+  }
+
+  // Barycentric coordinates of the point of the triangle abc closest to p,
+  // by the Voronoi regions of its vertices and edges [Ericson 2004, 5.1.5]
+  static glm::vec3 closestPoint(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+  {
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    const tReal d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if(d1 <= 0.f && d2 <= 0.f) return glm::vec3(1.f, 0.f, 0.f);
+
+    const glm::vec3 bp = p - b;
+    const tReal d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if(d3 >= 0.f && d4 <= d3) return glm::vec3(0.f, 1.f, 0.f);
+
+    const tReal vc = d1*d4 - d3*d2;
+    if(vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+      const tReal v = d1 / (d1 - d3);
+      return glm::vec3(1.f - v, v, 0.f);
+    }
+
+    const glm::vec3 cp = p - c;
+    const tReal d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if(d6 >= 0.f && d5 <= d6) return glm::vec3(0.f, 0.f, 1.f);
+
+    const tReal vb = d5*d2 - d1*d6;
+    if(vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+      const tReal w = d2 / (d2 - d6);
+      return glm::vec3(1.f - w, 0.f, w);
+    }
+
+    const tReal va = d3*d6 - d5*d4;
+    if(va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+      const tReal w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+      return glm::vec3(0.f, 1.f - w, w);
+    }
+
+    const tReal denom = va + vb + vc;
+    if(!(denom > 0.f))          // degenerate triangle
+      return glm::vec3(1.f, 0.f, 0.f);
+    const tReal v = vb / denom, w = vc / denom;
+    return glm::vec3(1.f - v - w, v, w);
+  }
+
+  std::vector<glm::uvec3> _vertices;  // coarse triangle of every fine vertex
+  std::vector<glm::vec4> _weights;    // its barycentric coordinates, and the normal offset
+};
+
+#endif  /* _MESHEMBEDDING_HPP_ */
@@ -0,0 +1,59 @@
+// ----------------------------------------------------------------------------
+// MeshTopology.hpp
+//
+// Description: Edges and bending hinges of a triangle mesh, shared by the
+//              cloth setup of PbdSolver and the mesh cache
+// ----------------------------------------------------------------------------
+
+#ifndef _MESHTOPOLOGY_HPP_
+#define _MESHTOPOLOGY_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+
+struct MeshTopology {
+  std::vector<glm::uvec2> edges;  // (i, j), i < j, in increasing order
+  std::vector<glm::uvec4> hinges; // (i, j, k, l): edge i-j shared by the triangles of k and l, in this order
+
+  void clear()
+  {
+    edges.clear();
+    hinges.clear();
+  }
+};
+
+// Half-edges (smaller index, larger index, order, opposite vertex) sorted by
+// edge: an edge is a run of one or two half-edges, the opposite vertices of
+// its triangles coming in the order of the triangles. Edges of one triangle
+// or of more than two have no hinge. half_edges is scratch, kept by the
+// caller so that its memory is reused.
+inline void buildMeshTopology(
+  const std::vector<glm::uvec3> &triangles, MeshTopology &topology, std::vector<glm::uvec4> &half_edges)
+{
+  half_edges.clear();
+  for(const auto &triangle : triangles) {
+    for(int i = 0; i < 3; ++i) {
+      const tUint a = triangle[i], b = triangle[(i + 1) % 3];
+      half_edges.push_back(glm::uvec4(std::min(a, b), std::max(a, b), half_edges.size(), triangle[(i + 2) % 3]));
+    }
+  }
+  std::sort(half_edges.begin(), half_edges.end(), [](const glm::uvec4 &a, const glm::uvec4 &b) {
+    return a[0] != b[0] ? a[0] < b[0] : a[1] != b[1] ? a[1] < b[1] : a[2] < b[2];
+  });
+
+  topology.clear();
+  for(tUint k = 0; k < half_edges.size(); ) {
+    tUint end = k + 1;
+    while(end < half_edges.size() && half_edges[end][0] == half_edges[k][0] && half_edges[end][1] == half_edges[k][1])
+      ++end;
+    topology.edges.push_back(glm::uvec2(half_edges[k][0], half_edges[k][1]));
+    if(end - k == 2)
+      topology.hinges.push_back(glm::uvec4(half_edges[k][0], half_edges[k][1], half_edges[k][3], half_edges[k+1][3]));
+    k = end;
+  }
+}
+
+#endif  /* _MESHTOPOLOGY_HPP_ */
@@ -0,0 +1,181 @@
+// ----------------------------------------------------------------------------
+// NeighborGrid.hpp
+//
+// Description: Uniform-grid neighbour search built by a parallel counting sort
+// ----------------------------------------------------------------------------
+
+#ifndef _NEIGHBORGRID_HPP_
+#define _NEIGHBORGRID_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "typedefs.hpp"
+
+// Exclusive prefix sum in place: every thread scans its own block, then adds
+// the totals of the blocks before it.
+inline void exclusiveScan(std::vector<tUint> &a)
+{
+  const int n = a.size();
+#ifdef _OPENMP
+  std::vector<tUint> block_sum(omp_get_max_threads() + 1, 0);
+#pragma omp parallel
+  {
+    const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+    const int begin = (long long)n*t/nt, end = (long long)n*(t + 1)/nt;
+    tUint sum = 0;
+    for(int i = begin; i < end; ++i) {
+      const tUint v = a[i];
+      a[i] = sum;
+      sum += v;
+    }
+    block_sum[t + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+    for(int k = 1; k <= nt; ++k)
+      block_sum[k] += block_sum[k - 1];
+    const tUint offset = block_sum[t];
+    for(int i = begin; i < end; ++i)
+      a[i] += offset;
+  }
+#else
+  tUint sum = 0;
+  for(int i = 0; i < n; ++i) {
+    const tUint v = a[i];
+    a[i] = sum;
+    sum += v;
+  }
+#endif
+}
+
+// Spatially hashed uniform grid: cells of the unbounded space are hashed into
+// a table about twice as large as the point count, and points are bucketed by
+// a counting sort so that every cell is a contiguous range of sortedIds(), in
+// increasing order of point id.
+class NeighborGrid {
+public:
+  void build(const std::vector<glm::vec3> &x, const tReal cell_size)
+  {
+    const int n = x.size();
+    _inv_h = 1.f / cell_size;
+
+    tUint table_size = 1024;
+    while(table_size < 2*x.size())
+      table_size *= 2;
+    _mask = table_size - 1;
+
+    // 1. bucket of every point, and the count per bucket
+    _count.assign(table_size, 0);
+    _bucket.resize(n);
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      const tUint b = bucketOf(cellOf(x[i]));
+      _bucket[i] = b;
+#pragma omp atomic
+      ++_count[b];
+    }
+
+    // 2. bucket ranges
+    exclusiveScan(_count);
+    _cell_start.resize(table_size + 1);
+    std::copy(_count.begin(), _count.end(), _cell_start.begin());
+    _cell_start[table_size] = n;
+
+    // 3. scatter; _count is reused as the insertion cursor
+    _sorted.resize(n);
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      tUint slot;
+#pragma omp atomic capture
+      slot = _count[_bucket[i]]++;
+      _sorted[slot] = i;
+    }
+
+    // 4. the scatter order depends on the threads: every bucket is sorted by
+    // point id, so that the sums over neighbours are the same on every run
+    const int num_buckets = table_size;
+#pragma omp parallel for schedule(static, 1024)
+    for(int b = 0; b < num_buckets; ++b) {
+      if(_cell_start[b+1] - _cell_start[b] > 1)
+        std::sort(_sorted.begin() + _cell_start[b], _sorted.begin() + _cell_start[b+1]);
+    }
+  }
+
+  const std::vector<tUint> &sortedIds() const { return _sorted; }
+
+  // Calls f(j) for every point j in the 27 cells around p; the caller tests
+  // the actual distance. Buckets shared by several of these cells are only
+  // visited once.
+  template <typename F>
+  void forEachNeighbor(const glm::vec3 &p, F f) const
+  {
+    if(_sorted.empty())
+      return;
+    const glm::ivec3 c = cellOf(p);
+    tUint visited[27];
+    int num_visited = 0;
+    for(int dx = -1; dx <= 1; ++dx) {
+      for(int dy = -1; dy <= 1; ++dy) {
+        for(int dz = -1; dz <= 1; ++dz) {
+          const tUint b = bucketOf(c + glm::ivec3(dx, dy, dz));
+          if(std::find(visited, visited + num_visited, b) != visited + num_visited)
+            continue;
+          visited[num_visited++] = b;
+          for(tUint k = _cell_start[b]; k < _cell_start[b+1]; ++k)
+            f(_sorted[k]);
+        }
+      }
+    }
+  }
+
+  // Calls f(j) for every point j in the cells overlapping the box p +- r, r
+  // being at most the cell size: 8 cells instead of 27 when r is at most
+  // half of it
+  template <typename F>
+  void forEachInBox(const glm::vec3 &p, const tReal r, F f) const
+  {
+    if(_sorted.empty())
+      return;
+    const glm::ivec3 lo = cellOf(p - r), hi = cellOf(p + r);
+    tUint visited[27];
+    int num_visited = 0;
+    for(int cx = lo[0]; cx <= hi[0]; ++cx) {
+      for(int cy = lo[1]; cy <= hi[1]; ++cy) {
+        for(int cz = lo[2]; cz <= hi[2]; ++cz) {
+          const tUint b = bucketOf(glm::ivec3(cx, cy, cz));
+          if(std::find(visited, visited + num_visited, b) != visited + num_visited)
+            continue;
+          visited[num_visited++] = b;
+          for(tUint k = _cell_start[b]; k < _cell_start[b+1]; ++k)
+            f(_sorted[k]);
+        }
+      }
+    }
+  }
+
+private:
+  glm::ivec3 cellOf(const glm::vec3 &p) const
+  {
+    return glm::ivec3(glm::floor(p*_inv_h));
+  }
+
+  tUint bucketOf(const glm::ivec3 &c) const
+  {
+    return ((tUint)c[0]*73856093u ^ (tUint)c[1]*19349663u ^ (tUint)c[2]*83492791u) & _mask;
+  }
+
+  tReal _inv_h = 1.f;
+  tUint _mask = 0;
+  std::vector<tUint> _bucket;     // bucket of every point
+  std::vector<tUint> _count;      // points per bucket, then insertion cursor
+  std::vector<tUint> _cell_start; // points of bucket b: sortedIds()[_cell_start[b] .. _cell_start[b+1]]
+  std::vector<tUint> _sorted;     // point ids sorted by bucket, then by id
+};
+
+#endif  /* _NEIGHBORGRID_HPP_ */
@@ -20,18 +20,33 @@
 #define _PBDSOLVER_HPP_
 
 #include <cmath>
-#include <set>
-#include <map>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <memory>
 #include <utility>
 #include <random>
 #include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
 
 #include "glm/fwd.hpp"
 #include "glm/geometric.hpp"
 #include "typedefs.hpp"
-#include "Mesh.h"
+#include "Arena.hpp"
+#include "BinaryCache.h"
+#include "MeshData.h"
+#include "TetMesh.h"
+#include "TetConstraints.hpp"
+#include "ShapeMatching.hpp"
+#include "PbfFluid.hpp"
+#include "RigidBodies.hpp"
+#include "ProjectiveDynamics.hpp"
+#include "LinearizedXpbd.hpp"
+#include "VertexNormals.hpp"
+#include "MeshTopology.hpp"
 
 struct Constraint {
   virtual void project(std::vector<glm::vec3> &x, std::vector<glm::vec3> &x_last, const std::vector<tReal> &w, tReal dt) = 0;
@@ -177,24 +192,58 @@ struct ConstraintBend : public Constraint {
 };
 
 
+const std::uint64_t kRestStateVersion = 1; // to change with computeRestState()
+
+// Solver of the cloth stretch and bend constraints
+enum class PbdBackend {
+  kXpbd,                        // XPBD Gauss-Seidel iterations
+  kProjective,                  // projective dynamics with a prefactored global step
+  kLinearized,                  // XPBD solving all the multipliers at once by PCG
+};
+
 class PbdSolver {
 public:
   explicit PbdSolver(
     const tUint num_solve=20,
     const tReal k_stretch=1e-9, const tReal k_bend=10, const tReal k_damp=0.0f,
-    const glm::vec3 &gravity=glm::vec3(0.f, -9.8f, 0.f)) :
+    const glm::vec3 &gravity=glm::vec3(0.f, -9.8f, 0.f),
+    const PbdBackend backend=PbdBackend::kXpbd) :
     _g(gravity), _step(0), _sim_t(0.0f),
-    _Ns(num_solve), _kStretch(k_stretch), _kBend(k_bend), _kDamp(k_damp) {}
+    _Ns(num_solve), _kStretch(k_stretch), _kBend(k_bend), _kDamp(k_damp),
+    _backend(backend), _projectiveP(false), _linearizedP(false), _fuseNormals(true) {}
+  PbdSolver(PbdSolver &&) = default; // not copyable, the constraints live in _arena
+  PbdSolver &operator=(PbdSolver &&) = default;
   virtual ~PbdSolver() {}
 
-  void initSim(const Mesh &mesh)
+  // Cloth: the vertices of the mesh are simulated, or, with weld as filled by
+  // loadOBJ() or loadPLY(), the welded vertices, updateMesh() copying them
+  // back to the vertices split at texture seams. The vertices of the mesh in
+  // pins are fixed at their positions; nothing is pinned by default.
+  void initSim(
+    const MeshData &mesh, const std::vector<tUint> &weld=std::vector<tUint>(),
+    const std::vector<tUint> &pins=std::vector<tUint>())
   {
-    _step = 0;
-    _sim_t = 0.0f;
-
-    _x = mesh.vertexPositions();
-    _x_next = mesh.vertexPositions();
-    _idx = mesh.triangleIndices();
+    clearSim();
+
+    reserve(mesh);
+
+    if (weld.empty()) {
+      _x = mesh.vertexPositions();
+      _idx = mesh.triangleIndices();
+    } else {
+      _surface = weld;
+      _x.resize(*std::max_element(weld.begin(), weld.end()) + 1);
+      for (tUint i = 0; i < weld.size(); ++i) {
+        _x[weld[i]] = mesh.vertexPositions()[i];
+      }
+      for (const auto &t : mesh.triangleIndices()) {
+        const glm::uvec3 w(weld[t[0]], weld[t[1]], weld[t[2]]);
+        if (w[0] != w[1] && w[1] != w[2] && w[2] != w[0]) { // collapsed by the welding
+          _idx.push_back(w);
+        }
+      }
+    }
+    _x_next = _x;
     _vertex_number = _x.size();
 
     // TODO - done: initialize physical variables _v, _f, _w
@@ -209,26 +258,12 @@ public:
 
     // create constraints:
 
-    // 1. edge-triangle information
-
-    std::set<std::set<tUint>> connections;                            // list of edges (pair of indexes of the beginning and ending)
-    std::map<std::set<tUint>, std::vector<tUint>> tri_neighbors;      // map from edge to the index of the opposite vertice of the triangle it belongs to
-                                                                      // assuming each edge would belong to no more than 2 triangles
-
-    for (auto& triangle: _idx) {
-      for (int i = 0; i < 3; i += 1) {
-        std::set<tUint> edge = {triangle[i], triangle[(i + 1) % 3]};
-        connections.insert(edge);
-        tri_neighbors[edge].push_back(triangle[(i + 2) % 3]);
-      }
-    }
-
-    // 2. attachments
+    // 1. attachments
 
     // in one corner
     // for (int i = 0; i < 15; ++i) {
     //   for (int j = 0; j < 3; ++j) {
-    //     _constraints.push_back(std::make_shared<ConstraintAttach>(ConstraintAttach(30 * j + i, _x[30 * j + i])));
+    //     _constraints.push_back(_arena.create<ConstraintAttach>(30 * j + i, _x[30 * j + i]));
     //     _w[i + 30 * j] = 0.f;
     //   }
     // }
@@ -236,82 +271,196 @@ public:
     // only two corner points
 
     // glm::vec3 constr_pos = _x[0];
-    // _constraints.push_back(std::make_shared<ConstraintAttach>(ConstraintAttach(0, constr_pos)));
-    // _constraints.push_back(std::make_shared<ConstraintAttach>(ConstraintAttach(420, _x[420])));
-    // _constraints.push_back(std::make_shared<ConstraintAttach>(ConstraintAttach(435, _x[435])));
+    // _constraints.push_back(_arena.create<ConstraintAttach>(0, constr_pos));
+    // _constraints.push_back(_arena.create<ConstraintAttach>(420, _x[420]));
+    // _constraints.push_back(_arena.create<ConstraintAttach>(435, _x[435]));
     // _w[0] = 0.f;
     // _w[420] = 0.f;
     // _w[435] = 0.f;
 
-    // a table
-    for (int i = 0; i < 16; ++i) {
-      for (int j = 0; j < 9; ++j) {
-        int index = 30 * (3 + j) + i + 7;
-        _constraints.push_back(std::make_shared<ConstraintAttach>(ConstraintAttach(index, _x[index])));
-        _w[index] = 0.f;
+    // the given ones, as the table of the demo scene
+    for (tUint p : pins) {
+      if (p >= mesh.vertexPositions().size()) {
+        continue;
+      }
+      const tUint index = weld.empty() ? p : weld[p];
+      if (_w[index] == 0) {     // welded to a pin already
+        continue;
+      }
+      _constraints.push_back(_arena.create<ConstraintAttach>(index, _x[index]));
+      _w[index] = 0.f;
+    }
+
+    _pins.clear();
+    for (int i = 0; i < _vertex_number; ++i) {
+      if (_w[i] == 0) {
+        _pins.push_back(i);
       }
     }
 
+    // 2. edges and hinges with their rest lengths and angles, unless those of
+    // the last simulation or of the cache directory are for the same input
+
+    const std::uint64_t key = restStateKey();
+    if (key != _rest_key && !loadRestState(key)) {
+      computeRestState();
+      saveRestState(key);
+    }
+    _rest_key = key;
+
     // 3. stretch
 
-    for (auto& edge : connections) {
-      tUint i = *edge.begin();
-      tUint j = *(++edge.begin());
-      
+    for (tUint c = 0; c < _topology.edges.size(); ++c) {
+      tUint i = _topology.edges[c][0];
+      tUint j = _topology.edges[c][1];
+
       if (_w[i] == 0 && _w[j] == 0) {
         continue;
       }
 
-      tReal len = glm::length(_x[i] - _x[j]);
-      _constraints.push_back(std::make_shared<ConstraintStretch>(ConstraintStretch(i, j, len, _kStretch, 0.9)));
+      _constraints.push_back(_arena.create<ConstraintStretch>(i, j, _rest_length[c], _kStretch, 0.9));
     }
 
     // 4. bend
 
-    for (auto& edge : connections) {
-      if (tri_neighbors[edge].size() == 2) {
+    for (tUint c = 0; c < _topology.hinges.size(); ++c) {
+      const glm::uvec4 &hinge = _topology.hinges[c];
 
-        // PBD bend:
-        // base edge begin and end
-        int i1 = *edge.begin();
-        int i2 = *(++edge.begin());
+      // PBD bend:
+      // base edge begin and end
+      int i1 = hinge[0];
+      int i2 = hinge[1];
 
-        // points that belong to the same triangle as the edge
-        int i3 = *tri_neighbors[edge].begin();
-        int i4 = *(++tri_neighbors[edge].begin());
+      // points that belong to the same triangle as the edge
+      int i3 = hinge[2];
+      int i4 = hinge[3];
 
-        if (_w[i1] == 0 && _w[i2] == 0 && _w[i3] == 0 && _w[i4] == 0) {
-          continue;
-        }
+      if (_w[i1] == 0 && _w[i2] == 0 && _w[i3] == 0 && _w[i4] == 0) {
+        continue;
+      }
 
-        const glm::vec3 p2 = _x[i2] - _x[i1];
-        const glm::vec3 p3 = _x[i3] - _x[i1];
-        const glm::vec3 p4 = _x[i4] - _x[i1];
-        const glm::vec3 n1 = glm::normalize(glm::cross(p2, p3));
-        const glm::vec3 n2 = glm::normalize(glm::cross(p2, p4));
-        const tReal phi_0 = std::acos(glm::dot(n1, n2));
+      _constraints.push_back(_arena.create<ConstraintBend>(i1, i2, i3, i4, _rest_angle[c], _kBend, 0.05));
 
-        _constraints.push_back(std::make_shared<ConstraintBend>(ConstraintBend(i1, i2, i3, i4, phi_0, _kBend, 0.05)));
 
+      // simplified bend:
 
-        // simplified bend:
+      // tReal len = glm::length(_x[i3] - _x[i4]);
+      // _constraints.push_back(_arena.create<ConstraintStretch>(i3, i4, len, _kBend, _kDamp));
+    }
 
-        // int i = *tri_neighbors[edge].begin();
-        // int j = *(++tri_neighbors[edge].begin());
-        // tReal len = glm::length(_x[i] - _x[j]);
-        // _constraints.push_back(std::make_shared<ConstraintStretch>(ConstraintStretch(i, j, len, _kBend, _kDamp)));
+    // 5. projective dynamics: the pins are the vertices of zero inverse mass
+    if (_backend == PbdBackend::kProjective) {
+      _pd.build(_x, std::vector<tReal>(_vertex_number, 1.0), _topology.edges, _topology.hinges, _kStretch, _kBend, _pins);
+      _projectiveP = true;
+    } else if (_backend == PbdBackend::kLinearized) {
+      _lin.build(_x, _w, _idx, _topology.edges, _topology.hinges, _kStretch, _kBend, 0.9, 0.05);
+      _linearizedP = true;
+    }
 
-      } else {
-        // delete edges that belong to only one triangle or not good once
-        tri_neighbors.erase(edge);
-      }
+    _normals.build(_vertex_number, _idx);
+    _normals.compute(_x, _n);
+  }
+
+  // Soft body: every tet vertex is simulated, the mesh updated by updateMesh()
+  // being the one filled by body.extractSurface()
+  void initSim(const TetMesh &body, const TetMaterial &material=TetMaterial())
+  {
+    clearSim();
+
+    _x = body.vertexPositions();
+    _x_next = body.vertexPositions();
+    _vertex_number = _x.size();
+    _surface = body.surfaceVertices();
+    _normals.clear();           // built on the surface by updateMesh()
+
+    _tet_batches.resize(1);
+    _tet_batches[0].build(_x, body.tetIndices(), material);
+
+    std::vector<tReal> m(_vertex_number, 0.f);
+    _tet_batches[0].accumulateMass(m, material.density);
+    for (int i = 0; i < _vertex_number; ++i) {
+      _w.push_back(m[i] > 0.f ? 1.f / m[i] : 0.f);
+      _v.push_back(glm::vec3(0.0));
+      _f.push_back(m[i] * _g);
     }
   }
 
-  void updateMesh(Mesh &mesh)
+  // Shape-matching clusters over the vertices of the current simulation, given
+  // as vertex index sets (see clustersInRegion()); call after initSim()
+  void addShapeMatching(
+    const std::vector<std::vector<tUint>> &clusters,
+    const ShapeMatchingParams &params=ShapeMatchingParams())
+  {
+    _shape_batches.push_back(ShapeMatchingBatch());
+    _shape_batches.back().build(clusters, _x, _w, params);
+  }
+
+  // Fluid stepped in the same iteration loop, exchanging contacts with the
+  // simulated vertices; call after initSim()
+  void attachFluid(std::shared_ptr<PbfFluid> fluid)
+  {
+    _fluid = fluid;
+  }
+
+  // Rigid bodies stepped in the same iteration loop, so that their joints,
+  // contacts and attachments to the vertices are two-way; call after initSim()
+  void attachRigidBodies(std::shared_ptr<RigidBodies> bodies)
   {
-    mesh.vertexPositions() = _x;
-    mesh.recomputePerVertexNormals();
+    _rigid = bodies;
+  }
+
+  // Directory where the rest state of the cloth is kept between runs, in a
+  // file per input (see restStateKey()), created if missing; none by default
+  void setCacheDirectory(const std::string &directory)
+  {
+    _cache_dir = directory;
+    if (!directory.empty() && !makeDirectories(directory)) {
+      std::cerr << "[PbdSolver][setCacheDirectory] Warning: cannot create " << directory
+                << ", the rest states are not cached" << std::endl;
+      _cache_dir.clear();
+    }
+  }
+
+  // Normals of the cloth computed by the last pass of step(), or else by a
+  // separate pass over the mesh; on by default
+  void fuseNormals(const bool fuse)
+  {
+    _fuseNormals = fuse;
+  }
+
+  void updateMesh(MeshData &mesh)
+  {
+    if (_surface.empty()) {
+      mesh.vertexPositions() = _x;
+    } else {
+      auto &p = mesh.vertexPositions();
+      for (tUint i = 0; i < _surface.size(); ++i) {
+        p[i] = _x[_surface[i]];
+      }
+    }
+
+    // cloth: normals of the simulated vertices, so that seams do not show
+    if (_n.size() == _x.size()) {
+      if (!_fuseNormals) {
+        _normals.compute(_x, _n);
+      }
+      if (_surface.empty()) {
+        mesh.vertexNormals() = _n;
+      } else {
+        auto &n = mesh.vertexNormals();
+        n.resize(_surface.size());
+        for (tUint i = 0; i < _surface.size(); ++i) {
+          n[i] = _n[_surface[i]];
+        }
+      }
+      return;
+    }
+
+    // soft body: normals of its surface
+    if (!_normals.builtFor(mesh.vertexPositions().size(), mesh.triangleIndices().size())) {
+      _normals.build(mesh.vertexPositions().size(), mesh.triangleIndices());
+    }
+    _normals.compute(mesh.vertexPositions(), mesh.vertexNormals());
   }
 
   void step(const tReal dt)
@@ -325,23 +474,81 @@ public:
       // colision constraints can be here
     }
 
+    if (_projectiveP) {
+      _s = _x_next;
+      if (!_pd.solve(_x_next, _s, dt, _Ns)) {
+        std::cerr << "[PbdSolver][step] Warning: the projective dynamics system cannot be factored, "
+                  << "the cloth is solved by XPBD" << std::endl;
+        _projectiveP = false;   // its XPBD constraints are always built
+      }
+    } else if (_linearizedP) {
+      // the _Ns constraint passes are shared by the linearizations, with a
+      // floor below which truncated CG solves overshoot
+      _lin.solve(_x_next, _x, _w, dt, kLinearizedOuter, std::max<int>(_Ns/kLinearizedOuter, 8));
+    }
+
+    if (_fluid) {
+      _fluid->predict(dt, _g);
+    }
+    if (_rigid) {
+      _rigid->predict(dt, _g);
+    }
+
     for (auto constraint : _constraints) {
       constraint->reset();
     }
+    for (auto& batch : _tet_batches) {
+      batch.reset();
+    }
 
     for (int i = 0; i < _Ns; ++i) {
-      for (auto constraint : _constraints) {
-        constraint->project(_x_next, _x, _w, dt);
-      } 
+      if (!_projectiveP && !_linearizedP) { // otherwise already solved above
+        for (auto constraint : _constraints) {
+          constraint->project(_x_next, _x, _w, dt);
+        }
+      }
+      for (auto& batch : _tet_batches) {
+        batch.project(_x_next, _w, dt);
+      }
+      for (auto& batch : _shape_batches) {
+        batch.project(_x_next, _w, _Ns);
+      }
+      if (_rigid) {
+        _rigid->project(_x_next, _x, _w, dt);
+      }
+      if (_fluid) {
+        _fluid->projectDensity();
+        _fluid->collideCloth(_x_next, _w);
+      }
+    }
+
+    if (_fluid) {
+      _fluid->finalize(dt);
+    }
+    if (_rigid) {
+      _rigid->finalize(dt);
+    }
+
+    for (auto& batch : _shape_batches) {
+      batch.updatePlasticity(_x_next);
     }
 
     for (auto& x : _x_next) {
       x[1] = glm::clamp(x[1], 0.0001f - 1.f, 1.f);
     }
 
+    // the positions are final, so the normals can be gathered in the same pass
+    const bool normals = _fuseNormals && _n.size() == _x.size();
+    if (normals) {
+      _normals.computeCorners(_x_next);
+    }
+#pragma omp parallel for
     for (int i = 0; i < _vertex_number; ++i) {
       _v[i] = (_x_next[i] - _x[i]) / dt;
       _x[i] = _x_next[i];
+      if (normals) {
+        _n[i] = _normals.gather(i);
+      }
     }
 
     ++_step;
@@ -349,6 +556,123 @@ public:
   }
 
 private:
+  // Room for a simulation of the mesh, from bounds on the counts of edges and
+  // constraints; after a reset of a same-sized simulation nothing is allocated
+  void reserve(const MeshData &mesh)
+  {
+    const std::size_t nv = mesh.vertexPositions().size(), nh = 3*mesh.triangleIndices().size();
+    _x.reserve(nv);
+    _x_next.reserve(nv);
+    _v.reserve(nv);
+    _f.reserve(nv);
+    _w.reserve(nv);
+    _idx.reserve(nh/3);
+    _half_edges.reserve(nh);
+    _topology.edges.reserve(nh);
+    _topology.hinges.reserve(nh/2);
+    _rest_length.reserve(nh);
+    _rest_angle.reserve(nh/2);
+    _pins.reserve(nv);
+    _constraints.reserve(nv + nh + nh/2);
+    _arena.reserve(nv*sizeof(ConstraintAttach) + nh*sizeof(ConstraintStretch) + nh/2*sizeof(ConstraintBend));
+  }
+
+  // Hash of what the rest state depends on: rest positions, triangles and pins
+  std::uint64_t restStateKey() const
+  {
+    std::uint64_t key = hashBytes(_x.data(), _x.size()*sizeof(glm::vec3), kRestStateVersion);
+    key = hashBytes(_idx.data(), _idx.size()*sizeof(glm::uvec3), key);
+    return hashBytes(_pins.data(), _pins.size()*sizeof(tUint), key);
+  }
+
+  void computeRestState()
+  {
+    buildMeshTopology(_idx, _topology, _half_edges);
+
+    _rest_length.resize(_topology.edges.size());
+    for (tUint c = 0; c < _topology.edges.size(); ++c) {
+      _rest_length[c] = glm::length(_x[_topology.edges[c][0]] - _x[_topology.edges[c][1]]);
+    }
+
+    _rest_angle.resize(_topology.hinges.size());
+    for (tUint c = 0; c < _topology.hinges.size(); ++c) {
+      const glm::uvec4 &h = _topology.hinges[c];
+      const glm::vec3 p2 = _x[h[1]] - _x[h[0]];
+      const glm::vec3 p3 = _x[h[2]] - _x[h[0]];
+      const glm::vec3 p4 = _x[h[3]] - _x[h[0]];
+      const glm::vec3 n1 = glm::normalize(glm::cross(p2, p3));
+      const glm::vec3 n2 = glm::normalize(glm::cross(p2, p4));
+      _rest_angle[c] = std::acos(glm::dot(n1, n2));
+    }
+  }
+
+  std::string restStatePath(const std::uint64_t key) const
+  {
+    std::ostringstream path;
+    path << _cache_dir << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".xrest";
+    return path.str();
+  }
+
+  bool loadRestState(const std::uint64_t key)
+  {
+    CacheReader reader;
+    if (_cache_dir.empty() || !reader.open(restStatePath(key), key)) {
+      return false;
+    }
+    if (!(reader.read(cacheTag("EDGE"), _topology.edges) && reader.read(cacheTag("HNGE"), _topology.hinges) &&
+          reader.read(cacheTag("RLEN"), _rest_length) && reader.read(cacheTag("RANG"), _rest_angle) &&
+          _rest_length.size() == _topology.edges.size() && _rest_angle.size() == _topology.hinges.size())) {
+      return false;
+    }
+    // a damaged file must not index past the vertices
+    const tUint n = _vertex_number;
+    for (const glm::uvec2 &e : _topology.edges) {
+      if (e[0] >= n || e[1] >= n) {
+        return false;
+      }
+    }
+    for (const glm::uvec4 &h : _topology.hinges) {
+      if (h[0] >= n || h[1] >= n || h[2] >= n || h[3] >= n) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void saveRestState(const std::uint64_t key) const
+  {
+    if (_cache_dir.empty()) {
+      return;
+    }
+    CacheWriter writer;
+    writer.add(cacheTag("EDGE"), _topology.edges);
+    writer.add(cacheTag("HNGE"), _topology.hinges);
+    writer.add(cacheTag("RLEN"), _rest_length);
+    writer.add(cacheTag("RANG"), _rest_angle);
+    writer.write(restStatePath(key), key); // best effort
+  }
+
+  void clearSim()
+  {
+    _step = 0;
+    _sim_t = 0.0f;
+
+    _w.clear();
+    _v.clear();
+    _f.clear();
+    _idx.clear();
+    _constraints.clear();
+    _arena.reset();
+    _tet_batches.clear();
+    _shape_batches.clear();
+    _surface.clear();
+    _n.clear();
+    _fluid.reset();
+    _rigid.reset();
+    _projectiveP = false;       // _pd keeps its factorization
+    _linearizedP = false;
+  }
+
   std::vector<glm::vec3> _x;    // position
   std::vector<glm::vec3> _x_next;    // position
   std::vector<glm::vec3> _v;    // velocity
@@ -358,7 +682,20 @@ private:
 
   tUint _vertex_number;
 
-  std::vector< std::shared_ptr<Constraint> > _constraints; // constraints
+  Arena _arena;                 // storage of the constraints, kept over resets
+  std::vector<Constraint *> _constraints; // constraints
+  std::vector<glm::uvec4> _half_edges; // scratch of the edge discovery
+  MeshTopology _topology;              // of the cloth
+  std::vector<tReal> _rest_length;     // of _topology.edges
+  std::vector<tReal> _rest_angle;      // of _topology.hinges
+  std::vector<tUint> _pins;            // vertices of zero inverse mass
+  std::uint64_t _rest_key = 0;         // input of the rest state above
+  std::string _cache_dir;
+  std::vector<TetConstraintBatch> _tet_batches;           // soft-body constraints
+  std::vector<ShapeMatchingBatch> _shape_batches;         // rigid and plastic clusters
+  std::vector<tUint> _surface;  // simulated vertex of each rendered vertex, empty if identical
+  std::shared_ptr<PbfFluid> _fluid; // fluid coupled to the vertices, if any
+  std::shared_ptr<RigidBodies> _rigid; // rigid bodies coupled to the vertices, if any
 
   // simulation parameters
   glm::vec3 _g;                 // gravity
@@ -368,6 +705,17 @@ private:
   // PBD solver parameters
   tUint _Ns;                       // solver iterations
   tReal _kStretch, _kBend, _kDamp; // stiffness coefficients
+
+  PbdBackend _backend;
+  bool _projectiveP;            // cloth solved by _pd instead of _constraints
+  ProjectiveDynamics _pd;
+  std::vector<glm::vec3> _s;    // inertial prediction of the projective solve
+  bool _linearizedP;            // cloth solved by _lin instead of _constraints
+  LinearizedXpbd _lin;
+  VertexNormals _normals;       // of the cloth, or of the surface of the soft body
+  std::vector<glm::vec3> _n;    // normals of the cloth, updated by step()
+  bool _fuseNormals;
+  static const int kLinearizedOuter = 2; // linearizations per step
 };
 
 #endif  /* _PBDSOLVER_HPP_ */
@@ -0,0 +1,286 @@
+// ----------------------------------------------------------------------------
+// PbfFluid.hpp
+//
+// Description: Position Based Fluids [Macklin and Muller 2013], stepped inside
+//              the iteration loop of PbdSolver
+// ----------------------------------------------------------------------------
+
+#ifndef _PBFFLUID_HPP_
+#define _PBFFLUID_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "NeighborGrid.hpp"
+
+struct PbfParams {
+  tReal radius = 0.02f;         // particle radius; the rest spacing is 2*radius
+  tReal rest_density = 1000.f;
+  tReal relaxation = 100.f;     // constraint force mixing of the density constraint
+  tReal viscosity = 0.01f;      // XSPH coefficient
+  tReal vorticity = 1e-4f;      // vorticity confinement strength
+  tReal tensile_k = 1e-4f;      // artificial pressure against particle clumping
+  tReal cloth_thickness = 0.02f; // contact distance to cloth vertices on top of the radius;
+                                 // radius + thickness should cover the vertex spacing
+  glm::vec3 box_lo = glm::vec3(-2.f, -1.f, -2.f); // fluid domain
+  glm::vec3 box_hi = glm::vec3(2.f, 3.f, 2.f);
+};
+
+class PbfFluid {
+public:
+  explicit PbfFluid(const PbfParams &params=PbfParams()) : _p(params)
+  {
+    _h = 4.f*_p.radius;
+    _poly6 = 315.f / (64.f*tReal(M_PI)*std::pow(_h, 9.f));
+    _spiky = -45.f / (tReal(M_PI)*std::pow(_h, 6.f));
+    _w_corr = poly6(0.2f*_h*0.2f*_h);
+
+    // particle mass such that the rest lattice has exactly the rest density
+    const tReal spacing = 2.f*_p.radius;
+    tReal lattice = 0.f;
+    for(int i = -2; i <= 2; ++i)
+      for(int j = -2; j <= 2; ++j)
+        for(int k = -2; k <= 2; ++k)
+          lattice += poly6(spacing*spacing*(i*i + j*j + k*k));
+    _mass = _p.rest_density / lattice;
+  }
+
+  const std::vector<glm::vec3> &positions() const { return _x; }
+  tUint size() const { return _x.size(); }
+  const PbfParams &params() const { return _p; }
+
+  // Fill [lo, hi] with particles at the rest spacing
+  void addBlock(const glm::vec3 &lo, const glm::vec3 &hi, const glm::vec3 &velocity=glm::vec3(0.f))
+  {
+    const tReal spacing = 2.f*_p.radius;
+    for(tReal x = lo[0]; x <= hi[0]; x += spacing)
+      for(tReal y = lo[1]; y <= hi[1]; y += spacing)
+        for(tReal z = lo[2]; z <= hi[2]; z += spacing) {
+          _x.push_back(glm::vec3(x, y, z));
+          _v.push_back(velocity);
+        }
+  }
+
+  void clear()
+  {
+    _x.clear();
+    _v.clear();
+  }
+
+  // Unconstrained step, then neighbourhoods for the whole step. Particles are
+  // reordered along the grid so that neighbours are close in memory.
+  void predict(const tReal dt, const glm::vec3 &g)
+  {
+    const int n = size();
+    _x_next.resize(n);
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      _v[i] += dt*g;
+      _x_next[i] = _x[i] + dt*_v[i];
+    }
+
+    _grid.build(_x_next, _h);
+    const std::vector<tUint> &order = _grid.sortedIds();
+    permute(_x, order);
+    permute(_v, order);
+    permute(_x_next, order);
+    _grid.build(_x_next, _h);
+
+    // neighbour lists in CSR form: count, scan, fill
+    _nbr_start.assign(n + 1, 0); // the trailing 0 becomes the total count
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      tUint cnt = 0;
+      const glm::vec3 p = _x_next[i];
+      _grid.forEachNeighbor(p, [&](tUint j) {
+        if(j != (tUint)i && glm::dot(p - _x_next[j], p - _x_next[j]) < _h*_h) ++cnt;
+      });
+      _nbr_start[i] = cnt;
+    }
+    exclusiveScan(_nbr_start);
+    _nbr.resize(_nbr_start[n]);
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      tUint k = _nbr_start[i];
+      const glm::vec3 p = _x_next[i];
+      _grid.forEachNeighbor(p, [&](tUint j) {
+        if(j != (tUint)i && glm::dot(p - _x_next[j], p - _x_next[j]) < _h*_h) _nbr[k++] = j;
+      });
+    }
+
+    _lambda.resize(n);
+    _dx.resize(n);
+  }
+
+  // One Jacobi iteration of the density constraints
+  void projectDensity()
+  {
+    const int n = size();
+    const tReal inv_rho0 = 1.f / _p.rest_density;
+
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      const glm::vec3 p = _x_next[i];
+      tReal rho = _mass*poly6(0.f);
+      glm::vec3 grad_i(0.f);
+      tReal sum_grad2 = 0.f;
+      for(tUint k = _nbr_start[i]; k < _nbr_start[i+1]; ++k) {
+        const glm::vec3 r = p - _x_next[_nbr[k]];
+        rho += _mass*poly6(glm::dot(r, r));
+        const glm::vec3 grad_j = _mass*inv_rho0*spikyGrad(r);
+        grad_i += grad_j;
+        sum_grad2 += glm::dot(grad_j, grad_j);
+      }
+      sum_grad2 += glm::dot(grad_i, grad_i);
+      const tReal C = std::max(rho*inv_rho0 - 1.f, 0.f); // no attraction at free surfaces
+      _lambda[i] = -C / (sum_grad2 + _p.relaxation);
+    }
+
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      const glm::vec3 p = _x_next[i];
+      glm::vec3 dx(0.f);
+      for(tUint k = _nbr_start[i]; k < _nbr_start[i+1]; ++k) {
+        const tUint j = _nbr[k];
+        const glm::vec3 r = p - _x_next[j];
+        const tReal ratio = poly6(glm::dot(r, r)) / _w_corr;
+        const tReal s_corr = -_p.tensile_k*ratio*ratio*ratio*ratio;
+        dx += (_lambda[i] + _lambda[j] + s_corr)*spikyGrad(r);
+      }
+      _dx[i] = _mass*inv_rho0*dx;
+    }
+
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i)
+      _x_next[i] = glm::clamp(_x_next[i] + _dx[i], _p.box_lo + _p.radius, _p.box_hi - _p.radius);
+  }
+
+  // Contacts between particles and cloth vertices, both sides moved according
+  // to their inverse masses. Iterates over cloth vertices; the particle
+  // corrections are kept per vertex and summed in vertex order at the end, so
+  // that they do not depend on the threads.
+  void collideCloth(std::vector<glm::vec3> &x, const std::vector<tReal> &w)
+  {
+    const int n = size(), nc = x.size();
+    const tReal d = _p.radius + _p.cloth_thickness;
+    const tReal w_f = 1.f / _mass;
+    std::fill(_dx.begin(), _dx.end(), glm::vec3(0.f));
+    _cloth_contacts.resize(nc);
+
+#pragma omp parallel for
+    for(int c = 0; c < nc; ++c) {
+      std::vector<ClothContact> &contacts = _cloth_contacts[c];
+      contacts.clear();
+      glm::vec3 dxc(0.f);
+      _grid.forEachNeighbor(x[c], [&](tUint j) {
+        const glm::vec3 r = x[c] - _x_next[j];
+        const tReal dist2 = glm::dot(r, r);
+        if(dist2 >= d*d || dist2 < 1e-12f) return;
+        const tReal dist = std::sqrt(dist2);
+        const glm::vec3 corr = (d - dist) / (w[c] + w_f) * (r/dist);
+        dxc += w[c]*corr;
+        contacts.push_back(ClothContact{j, -w_f*corr});
+      });
+      x[c] += dxc;
+    }
+    for(int c = 0; c < nc; ++c) {
+      for(const ClothContact &contact : _cloth_contacts[c])
+        _dx[contact.j] += contact.dx;
+    }
+
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i)
+      _x_next[i] += _dx[i];
+  }
+
+  // Velocities from positions, then vorticity confinement and XSPH viscosity
+  void finalize(const tReal dt)
+  {
+    const int n = size();
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      _v[i] = (_x_next[i] - _x[i]) / dt;
+      _x[i] = _x_next[i];
+    }
+
+    // vorticity omega_i = sum_j v_ij x grad_j W_ij, with v_ij = v_j - v_i and
+    // grad_j W_ij = spikyGrad(x_j - x_i)
+    _omega.resize(n);
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      glm::vec3 omega(0.f);
+      for(tUint k = _nbr_start[i]; k < _nbr_start[i+1]; ++k) {
+        const tUint j = _nbr[k];
+        omega += glm::cross(_v[j] - _v[i], spikyGrad(_x[j] - _x[i]));
+      }
+      _omega[i] = omega;
+    }
+
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i) {
+      glm::vec3 eta(0.f), xsph(0.f);
+      for(tUint k = _nbr_start[i]; k < _nbr_start[i+1]; ++k) {
+        const tUint j = _nbr[k];
+        const glm::vec3 r = _x[i] - _x[j];
+        eta += glm::length(_omega[j])*spikyGrad(r);
+        xsph += (_v[j] - _v[i])*poly6(glm::dot(r, r));
+      }
+      glm::vec3 dv = _p.viscosity*_mass/_p.rest_density*xsph;
+      const tReal eta_len = glm::length(eta);
+      if(eta_len > 1e-6f)
+        dv += dt*_p.vorticity*glm::cross(eta/eta_len, _omega[i]);
+      _dx[i] = dv;              // applied below, once all the reads are done
+    }
+
+#pragma omp parallel for
+    for(int i = 0; i < n; ++i)
+      _v[i] += _dx[i];
+  }
+
+private:
+  tReal poly6(const tReal r2) const
+  {
+    const tReal d = std::max(_h*_h - r2, 0.f);
+    return _poly6*d*d*d;
+  }
+
+  glm::vec3 spikyGrad(const glm::vec3 &r) const
+  {
+    const tReal len = glm::length(r);
+    if(len >= _h || len < 1e-9f)
+      return glm::vec3(0.f);
+    return (_spiky*(_h - len)*(_h - len)/len)*r;
+  }
+
+  void permute(std::vector<glm::vec3> &a, const std::vector<tUint> &order)
+  {
+    const int n = a.size();
+    _tmp.resize(n);
+#pragma omp parallel for
+    for(int k = 0; k < n; ++k)
+      _tmp[k] = a[order[k]];
+    a.swap(_tmp);
+  }
+
+  PbfParams _p;
+  tReal _h, _mass;              // kernel support and particle mass
+  tReal _poly6, _spiky, _w_corr; // kernel constants
+
+  std::vector<glm::vec3> _x, _x_next, _v;
+  std::vector<tReal> _lambda;
+  std::vector<glm::vec3> _dx, _omega, _tmp;
+
+  struct ClothContact {
+    tUint j;                    // particle
+    glm::vec3 dx;               // its correction
+  };
+
+  NeighborGrid _grid;
+  std::vector<std::vector<ClothContact>> _cloth_contacts; // per cloth vertex
+  std::vector<tUint> _nbr_start, _nbr; // neighbours of i: _nbr[_nbr_start[i] .. _nbr_start[i+1]]
+};
+
+#endif  /* _PBFFLUID_HPP_ */
@@ -0,0 +1,248 @@
+// ----------------------------------------------------------------------------
+// ProjectiveDynamics.hpp
+//
+// Description: Projective dynamics [Bouaziz et al. 2014] for the stretch and
+//              bend constraints of the cloth, as an alternative to the XPBD
+//              Gauss-Seidel loop of PbdSolver
+// ----------------------------------------------------------------------------
+
+#ifndef _PROJECTIVEDYNAMICS_HPP_
+#define _PROJECTIVEDYNAMICS_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "SparseCholesky.hpp"
+
+const double kPdPinWeight = 1e12; // weight of the pin constraints
+const tReal kPdMaxStretchWeight = 1e6f; // stiffer edges lock the local/global iterations
+
+// The system matrix M/h^2 + sum_c w_c A_c^T A_c is constant, so it is factored
+// once. build() keeps the factor when the assembled matrix is unchanged since
+// the last call, as after a reset; different pins or a different time step
+// refactor it without new analysis. Pins are not folded in by rank-one
+// updates: removing their weight from a pivot of order m/h^2 would cancel
+// most of its digits.
+class ProjectiveDynamics {
+public:
+  // Edges are stretch constraints of rest length |x_i - x_j|. A hinge (i1, i2,
+  // i3, i4) is the edge i1-i2 shared by the triangles of i3 and i4, bent by
+  // the quadratic model of [Bergou et al. 2006].
+  void build(
+    const std::vector<glm::vec3> &x, const std::vector<tReal> &m,
+    const std::vector<glm::uvec2> &edges, const std::vector<glm::uvec4> &hinges,
+    const tReal k_stretch, const tReal k_bend, const std::vector<tUint> &pins)
+  {
+    const tUint n = x.size();
+    _m = m;
+    _edges = edges;
+    _hinges = hinges;
+
+    _edge_len.resize(edges.size());
+    _edge_w.resize(edges.size());
+    for(tUint c = 0; c < edges.size(); ++c) {
+      _edge_len[c] = glm::length(x[edges[c][0]] - x[edges[c][1]]);
+      _edge_w[c] = std::min(1.f / k_stretch, kPdMaxStretchWeight); // the XPBD compliance is an inverse stiffness
+    }
+
+    _hinge_K.resize(hinges.size());
+    _hinge_len.resize(hinges.size());
+    _hinge_w.resize(hinges.size());
+    for(tUint c = 0; c < hinges.size(); ++c) {
+      // |K x| is about the bend angle times the edge length, which gives the
+      // weight matching the angle compliance of the XPBD bend constraint
+      const glm::vec3 e = x[hinges[c][1]] - x[hinges[c][0]];
+      _hinge_K[c] = bendStencil(x, hinges[c]);
+      _hinge_len[c] = glm::length(applyStencil(x, c));
+      _hinge_w[c] = 1.f / (k_bend*glm::dot(e, e));
+    }
+
+    // pattern of the vertex graph with the diagonal, then the values
+    std::vector<std::vector<tUint>> adj(n);
+    for(tUint i = 0; i < n; ++i) adj[i].push_back(i);
+    for(const auto &e : edges) link(adj, e[0], e[1]);
+    for(const auto &h : hinges)
+      for(int a = 0; a < 4; ++a)
+        for(int b = a + 1; b < 4; ++b)
+          link(adj, h[a], h[b]);
+    std::vector<tUint> Ap(n + 1, 0), Ai;
+    for(tUint i = 0; i < n; ++i) {
+      std::sort(adj[i].begin(), adj[i].end());
+      Ai.insert(Ai.end(), adj[i].begin(), adj[i].end());
+      Ap[i+1] = Ai.size();
+    }
+    std::vector<double> Ax(Ai.size(), 0.0); // without the mass and pin terms
+    for(tUint c = 0; c < edges.size(); ++c) {
+      const tUint ids[2] = {edges[c][0], edges[c][1]};
+      const tReal K[2] = {1.f, -1.f};
+      scatter(Ap, Ai, Ax, ids, K, 2, _edge_w[c]);
+    }
+    for(tUint c = 0; c < hinges.size(); ++c) {
+      const tUint ids[4] = {hinges[c][0], hinges[c][1], hinges[c][2], hinges[c][3]};
+      const tReal K[4] = {_hinge_K[c][0], _hinge_K[c][1], _hinge_K[c][2], _hinge_K[c][3]};
+      scatter(Ap, Ai, Ax, ids, K, 4, _hinge_w[c]);
+    }
+
+    const bool same_system = n == _ldlt.size() && Ap == _Ap && Ai == _Ai && Ax == _Ax && m == _m_factored;
+    if(!same_system) {
+      _Ap.swap(Ap);
+      _Ai.swap(Ai);
+      _Ax.swap(Ax);
+      _m_factored = m;
+      _ldlt.analyze(n, _Ap, _Ai);
+      _pinned.assign(n, false);
+      _dt_factored = 0.f;       // numeric factorization on the next step
+    }
+
+    std::vector<bool> pinned(n, false);
+    for(tUint i : pins) pinned[i] = true;
+    if(pinned != _pinned)
+      _dt_factored = 0.f;       // numeric factorization on the next step
+    _pinned.swap(pinned);
+    _pin_pos.resize(n);
+    for(tUint i : pins) _pin_pos[i] = x[i];
+
+    _p_edge.resize(edges.size());
+    _p_hinge.resize(hinges.size());
+    _rhs.resize(n);
+  }
+
+  // Local/global iterations from the inertial prediction s = x + h v + h^2 f/m
+  // to the positions x_next. The local projections are independent. False,
+  // with x_next unchanged, if the system matrix cannot be factored.
+  bool solve(std::vector<glm::vec3> &x_next, const std::vector<glm::vec3> &s, const tReal dt, const int num_iterations)
+  {
+    const int n = s.size();
+    if(!refactorIfNeeded(dt))
+      return false;
+    const tReal inv_h2 = 1.f / (_dt_factored*_dt_factored);
+
+    for(int it = 0; it < num_iterations; ++it) {
+      const int ne = _edges.size(), nh = _hinges.size();
+#pragma omp parallel for
+      for(int c = 0; c < ne; ++c) {
+        const glm::vec3 d = x_next[_edges[c][0]] - x_next[_edges[c][1]];
+        const tReal len = glm::length(d);
+        _p_edge[c] = len > 1e-9f ? (_edge_len[c]/len)*d : glm::vec3(0.f);
+      }
+#pragma omp parallel for
+      for(int c = 0; c < nh; ++c) {
+        const glm::vec3 k = applyStencil(x_next, c);
+        const tReal len = glm::length(k);
+        _p_hinge[c] = len > 1e-9f ? (_hinge_len[c]/len)*k : glm::vec3(0.f);
+      }
+
+#pragma omp parallel for
+      for(int i = 0; i < n; ++i) {
+        _rhs[i] = glm::dvec3(_m[i]*inv_h2*s[i]);
+        if(_pinned[i])
+          _rhs[i] += kPdPinWeight*glm::dvec3(_pin_pos[i]);
+      }
+      for(int c = 0; c < ne; ++c) {
+        const glm::dvec3 p = double(_edge_w[c])*glm::dvec3(_p_edge[c]);
+        _rhs[_edges[c][0]] += p;
+        _rhs[_edges[c][1]] -= p;
+      }
+      for(int c = 0; c < nh; ++c) {
+        const glm::dvec3 p = double(_hinge_w[c])*glm::dvec3(_p_hinge[c]);
+        for(int a = 0; a < 4; ++a)
+          _rhs[_hinges[c][a]] += double(_hinge_K[c][a])*p;
+      }
+
+      _ldlt.solve(_rhs);
+#pragma omp parallel for
+      for(int i = 0; i < n; ++i)
+        x_next[i] = _pinned[i] ? _pin_pos[i] : glm::vec3(_rhs[i]);
+    }
+    return true;
+  }
+
+private:
+  // The factor is kept while the step stays within 10% of the factored one;
+  // the viewer steps with the wall-clock frame time. False if the matrix is
+  // not positive definite, as with a degenerate step.
+  bool refactorIfNeeded(const tReal dt)
+  {
+    if(_dt_factored > 0.f && std::abs(dt - _dt_factored) <= 0.1f*_dt_factored)
+      return true;
+    _dt_factored = 0.f;
+    std::vector<double> Ax = _Ax;
+    for(tUint i = 0; i < _ldlt.size(); ++i) {
+      const tUint d = std::lower_bound(_Ai.begin() + _Ap[i], _Ai.begin() + _Ap[i+1], i) - _Ai.begin();
+      Ax[d] += _m[i] / (double(dt)*dt) + (_pinned[i] ? kPdPinWeight : 0.0);
+    }
+    if(!_ldlt.factor(_Ap, _Ai, Ax))
+      return false;
+    _dt_factored = dt;
+    return true;
+  }
+
+  static void link(std::vector<std::vector<tUint>> &adj, const tUint i, const tUint j)
+  {
+    if(std::find(adj[i].begin(), adj[i].end(), j) == adj[i].end()) {
+      adj[i].push_back(j);
+      adj[j].push_back(i);
+    }
+  }
+
+  // Adds w K K^T on the rows and columns ids
+  static void scatter(
+    const std::vector<tUint> &Ap, const std::vector<tUint> &Ai, std::vector<double> &Ax,
+    const tUint *ids, const tReal *K, const int size, const tReal w)
+  {
+    for(int a = 0; a < size; ++a) {
+      for(int b = 0; b < size; ++b) {
+        const tUint i = ids[a], j = ids[b];
+        const tUint p = std::lower_bound(Ai.begin() + Ap[i], Ai.begin() + Ap[i+1], j) - Ai.begin();
+        Ax[p] += double(w)*K[a]*K[b];
+      }
+    }
+  }
+
+  static tReal cotan(const glm::vec3 &a, const glm::vec3 &b)
+  {
+    const tReal s = glm::length(glm::cross(a, b));
+    return s > 1e-12f ? glm::dot(a, b) / s : 0.f;
+  }
+
+  // Weights of the discrete mean curvature across the edge x0-x1
+  static glm::vec4 bendStencil(const std::vector<glm::vec3> &x, const glm::uvec4 &h)
+  {
+    const glm::vec3 e0 = x[h[1]] - x[h[0]], e1 = x[h[2]] - x[h[0]], e2 = x[h[3]] - x[h[0]];
+    const glm::vec3 e3 = x[h[2]] - x[h[1]], e4 = x[h[3]] - x[h[1]];
+    const tReal c01 = cotan(e0, e1), c02 = cotan(e0, e2), c03 = cotan(-e0, e3), c04 = cotan(-e0, e4);
+    return glm::vec4(c03 + c04, c01 + c02, -c01 - c03, -c02 - c04);
+  }
+
+  glm::vec3 applyStencil(const std::vector<glm::vec3> &x, const tUint c) const
+  {
+    const glm::uvec4 &h = _hinges[c];
+    const glm::vec4 &K = _hinge_K[c];
+    return K[0]*x[h[0]] + K[1]*x[h[1]] + K[2]*x[h[2]] + K[3]*x[h[3]];
+  }
+
+  std::vector<tReal> _m;
+  std::vector<glm::uvec2> _edges;
+  std::vector<tReal> _edge_len, _edge_w;
+  std::vector<glm::uvec4> _hinges;
+  std::vector<glm::vec4> _hinge_K;
+  std::vector<tReal> _hinge_len, _hinge_w;
+  std::vector<bool> _pinned;
+  std::vector<glm::vec3> _pin_pos;
+
+  // cached system: constraint part of the matrix, the masses it was factored
+  // with, and the step size of the factor
+  std::vector<tUint> _Ap, _Ai;
+  std::vector<double> _Ax;
+  std::vector<tReal> _m_factored;
+  tReal _dt_factored = 0.f;
+  SparseLDLT _ldlt;
+
+  std::vector<glm::vec3> _p_edge, _p_hinge; // projections of the local step
+  std::vector<glm::dvec3> _rhs;
+};
+
+#endif  /* _PROJECTIVEDYNAMICS_HPP_ */
@@ -0,0 +1,445 @@
+// ----------------------------------------------------------------------------
+// RigidBodies.hpp
+//
+// Description: XPBD rigid bodies [Muller et al. 2020] with ball and hinge
+//              joints, floor contacts and two-way coupling to the particles of
+//              PbdSolver. Body state is stored SoA.
+// ----------------------------------------------------------------------------
+
+#ifndef _RIGIDBODIES_HPP_
+#define _RIGIDBODIES_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "typedefs.hpp"
+#include "NeighborGrid.hpp"
+
+struct RigidParams {
+  tReal floor = -1.f;           // height of the ground plane, as the cloth clamp in PbdSolver
+  tReal friction = 0.5f;        // static friction against the floor and the particles
+  tReal cloth_thickness = 0.01f; // contact distance of particles to the box faces
+};
+
+// Boxes, since the viewer draws every body as a scaled cube. A body of zero
+// density is kinematic: it moves with the velocity given to setVelocity() and
+// is not affected by the constraints.
+class RigidBodies {
+public:
+  static const int kWorld = -1; // joint end fixed in the world
+
+  explicit RigidBodies(const RigidParams &params=RigidParams()) : _prm(params) {}
+
+  tUint size() const { return _p.size(); }
+  const RigidParams &params() const { return _prm; }
+
+  tUint addBox(
+    const glm::vec3 &center, const glm::vec3 &half_extents, const tReal density,
+    const glm::quat &orientation=glm::quat(1.f, 0.f, 0.f, 0.f))
+  {
+    const tReal m = density*8.f*half_extents[0]*half_extents[1]*half_extents[2];
+    const glm::vec3 h2 = half_extents*half_extents;
+    const glm::vec3 I = m/3.f*glm::vec3(h2[1] + h2[2], h2[0] + h2[2], h2[0] + h2[1]);
+    _p.push_back(center);
+    _q.push_back(orientation);
+    _p_prev.push_back(center);
+    _q_prev.push_back(orientation);
+    _v.push_back(glm::vec3(0.f));
+    _omega.push_back(glm::vec3(0.f));
+    _inv_mass.push_back(m > 0.f ? 1.f/m : 0.f);
+    _inv_inertia.push_back(m > 0.f ? 1.f/I : glm::vec3(0.f));
+    _half.push_back(half_extents);
+    return size() - 1;
+  }
+
+  void setVelocity(const tUint b, const glm::vec3 &v, const glm::vec3 &omega=glm::vec3(0.f))
+  {
+    _v[b] = v;
+    _omega[b] = omega;
+  }
+
+  const glm::vec3 &position(const tUint b) const { return _p[b]; }
+  const glm::quat &orientation(const tUint b) const { return _q[b]; }
+  const glm::vec3 &halfExtents(const tUint b) const { return _half[b]; }
+
+  // Transformation of the cube [-1, 1]^3 onto body b
+  glm::mat4 modelMatrix(const tUint b) const
+  {
+    return glm::translate(glm::mat4(1.f), _p[b])*glm::mat4_cast(_q[b])*glm::scale(glm::mat4(1.f), _half[b]);
+  }
+
+  // Joints at a world-space anchor; b1 or b2 may be kWorld
+  void addBallJoint(const int b1, const int b2, const glm::vec3 &anchor, const tReal compliance=0.f)
+  {
+    addJoint(b1, b2, anchor, glm::vec3(0.f), false, compliance);
+  }
+
+  // The two bodies only rotate relatively about the world-space axis
+  void addHingeJoint(
+    const int b1, const int b2, const glm::vec3 &anchor, const glm::vec3 &axis,
+    const tReal compliance=0.f)
+  {
+    addJoint(b1, b2, anchor, glm::normalize(axis), true, compliance);
+  }
+
+  // Ties particle i to the point of body b currently at the world-space anchor
+  void attachParticle(const tUint i, const tUint b, const glm::vec3 &anchor, const tReal compliance=0.f)
+  {
+    _att_particle.push_back(i);
+    _att_body.push_back(b);
+    _att_r.push_back(toLocal(b, anchor));
+    _att_alpha.push_back(compliance);
+    _att_lambda.push_back(0.f);
+  }
+
+  void clear()
+  {
+    *this = RigidBodies(_prm);
+  }
+
+  // Unconstrained step of the bodies; the Lagrange multipliers restart
+  void predict(const tReal dt, const glm::vec3 &g)
+  {
+    const int n = size();
+#pragma omp parallel for
+    for(int b = 0; b < n; ++b) {
+      _p_prev[b] = _p[b];
+      _q_prev[b] = _q[b];
+      if(_inv_mass[b] > 0.f) {
+        _v[b] += dt*g;
+        // gyroscopic term, in the body frame
+        const glm::vec3 I = 1.f/_inv_inertia[b];
+        const glm::vec3 w = glm::conjugate(_q[b])*_omega[b];
+        _omega[b] += _q[b]*(dt*_inv_inertia[b]*(-glm::cross(w, I*w)));
+      }
+      _p[b] += dt*_v[b];
+      integrateRotation(b, dt*_omega[b]);
+    }
+
+    std::fill(_joint_lambda_pos.begin(), _joint_lambda_pos.end(), 0.f);
+    std::fill(_joint_lambda_ang.begin(), _joint_lambda_ang.end(), 0.f);
+    std::fill(_att_lambda.begin(), _att_lambda.end(), 0.f);
+  }
+
+  // One Gauss-Seidel sweep over joints, attachments and contacts. x, x_last
+  // and w are the predicted and last positions and the inverse masses of the
+  // particles of PbdSolver.
+  void project(
+    std::vector<glm::vec3> &x, const std::vector<glm::vec3> &x_last,
+    const std::vector<tReal> &w, const tReal dt)
+  {
+    const tReal inv_dt2 = 1.f / (dt*dt);
+
+    for(tUint j = 0; j < _joint_b1.size(); ++j) {
+      const int b1 = _joint_b1[j], b2 = _joint_b2[j];
+      const tReal alpha = _joint_alpha[j]*inv_dt2;
+      if(_joint_hinge[j]) {
+        const glm::vec3 a1 = b1 == kWorld ? _joint_a1[j] : _q[b1]*_joint_a1[j];
+        const glm::vec3 a2 = b2 == kWorld ? _joint_a2[j] : _q[b2]*_joint_a2[j];
+        applyAngular(b1, b2, glm::cross(a1, a2), alpha, _joint_lambda_ang[j]);
+      }
+      const glm::vec3 r1 = worldOffset(b1, _joint_r1[j]), r2 = worldOffset(b2, _joint_r2[j]);
+      applyPositional(b1, r1, b2, r2, anchor(b2, r2) - anchor(b1, r1), alpha, _joint_lambda_pos[j]);
+    }
+
+    for(tUint k = 0; k < _att_particle.size(); ++k) {
+      const tUint i = _att_particle[k];
+      const int b = _att_body[k];
+      const glm::vec3 r = worldOffset(b, _att_r[k]);
+      applyParticle(x[i], w[i], b, r, x[i] - anchor(b, r), _att_alpha[k]*inv_dt2, _att_lambda[k]);
+    }
+
+    collideFloor();
+    collideParticles(x, x_last, w);
+  }
+
+  // Velocities from the corrected poses
+  void finalize(const tReal dt)
+  {
+    const int n = size();
+#pragma omp parallel for
+    for(int b = 0; b < n; ++b) {
+      _v[b] = (_p[b] - _p_prev[b]) / dt;
+      const glm::quat dq = _q[b]*glm::conjugate(_q_prev[b]);
+      _omega[b] = (dq.w >= 0.f ? 2.f : -2.f)/dt*glm::vec3(dq.x, dq.y, dq.z);
+    }
+  }
+
+private:
+  void addJoint(
+    const int b1, const int b2, const glm::vec3 &anchor, const glm::vec3 &axis,
+    const bool hinge, const tReal compliance)
+  {
+    _joint_b1.push_back(b1);
+    _joint_b2.push_back(b2);
+    _joint_r1.push_back(toLocal(b1, anchor));
+    _joint_r2.push_back(toLocal(b2, anchor));
+    _joint_a1.push_back(b1 == kWorld ? axis : glm::conjugate(_q[b1])*axis);
+    _joint_a2.push_back(b2 == kWorld ? axis : glm::conjugate(_q[b2])*axis);
+    _joint_hinge.push_back(hinge);
+    _joint_alpha.push_back(compliance);
+    _joint_lambda_pos.push_back(0.f);
+    _joint_lambda_ang.push_back(0.f);
+  }
+
+  // Points of the world are their own local coordinates
+  glm::vec3 toLocal(const int b, const glm::vec3 &x) const
+  {
+    return b == kWorld ? x : glm::conjugate(_q[b])*(x - _p[b]);
+  }
+  glm::vec3 worldOffset(const int b, const glm::vec3 &r) const
+  {
+    return b == kWorld ? r : _q[b]*r;
+  }
+  glm::vec3 anchor(const int b, const glm::vec3 &r) const
+  {
+    return b == kWorld ? r : _p[b] + r;
+  }
+
+  glm::vec3 applyInvInertia(const int b, const glm::vec3 &v) const
+  {
+    return _q[b]*(_inv_inertia[b]*(glm::conjugate(_q[b])*v));
+  }
+
+  void integrateRotation(const int b, const glm::vec3 &dtheta)
+  {
+    _q[b] = glm::normalize(_q[b] + 0.5f*glm::quat(0.f, dtheta[0], dtheta[1], dtheta[2])*_q[b]);
+  }
+
+  // Generalized inverse mass of body b at offset r along n
+  tReal generalizedInvMass(const int b, const glm::vec3 &r, const glm::vec3 &n) const
+  {
+    if(b == kWorld)
+      return 0.f;
+    const glm::vec3 rn = glm::cross(r, n);
+    return _inv_mass[b] + glm::dot(rn, applyInvInertia(b, rn));
+  }
+
+  void applyImpulse(const int b, const glm::vec3 &r, const glm::vec3 &p)
+  {
+    if(b == kWorld || _inv_mass[b] == 0.f)
+      return;
+    _p[b] += _inv_mass[b]*p;
+    integrateRotation(b, applyInvInertia(b, glm::cross(r, p)));
+  }
+
+  // Moves the point r of b1 by corr relative to the point r2 of b2
+  void applyPositional(
+    const int b1, const glm::vec3 &r1, const int b2, const glm::vec3 &r2,
+    const glm::vec3 &corr, const tReal alpha_tilda, tReal &lambda)
+  {
+    const tReal c = glm::length(corr);
+    if(c < 1e-7f)
+      return;
+    const glm::vec3 n = corr/c;
+    const tReal w = generalizedInvMass(b1, r1, n) + generalizedInvMass(b2, r2, n);
+    if(w + alpha_tilda < 1e-12f)
+      return;
+    const tReal dlambda = (c - alpha_tilda*lambda) / (w + alpha_tilda);
+    lambda += dlambda;
+    applyImpulse(b1, r1, dlambda*n);
+    applyImpulse(b2, r2, -dlambda*n);
+  }
+
+  // Rotates b1 by dtheta relative to b2
+  void applyAngular(
+    const int b1, const int b2, const glm::vec3 &dtheta,
+    const tReal alpha_tilda, tReal &lambda)
+  {
+    const tReal c = glm::length(dtheta);
+    if(c < 1e-7f)
+      return;
+    const glm::vec3 n = dtheta/c;
+    tReal w = 0.f;
+    if(b1 != kWorld) w += glm::dot(n, applyInvInertia(b1, n));
+    if(b2 != kWorld) w += glm::dot(n, applyInvInertia(b2, n));
+    if(w + alpha_tilda < 1e-12f)
+      return;
+    const tReal dlambda = (c - alpha_tilda*lambda) / (w + alpha_tilda);
+    lambda += dlambda;
+    if(b1 != kWorld && _inv_mass[b1] > 0.f) integrateRotation(b1, applyInvInertia(b1, dlambda*n));
+    if(b2 != kWorld && _inv_mass[b2] > 0.f) integrateRotation(b2, -applyInvInertia(b2, dlambda*n));
+  }
+
+  // Moves particle x (inverse mass w_x) by corr relative to the point r of b
+  void applyParticle(
+    glm::vec3 &x, const tReal w_x, const int b, const glm::vec3 &r,
+    const glm::vec3 &corr, const tReal alpha_tilda, tReal &lambda)
+  {
+    const tReal c = glm::length(corr);
+    if(c < 1e-7f)
+      return;
+    const glm::vec3 n = corr/c;
+    const tReal w = w_x + generalizedInvMass(b, r, n);
+    if(w + alpha_tilda < 1e-12f)
+      return;
+    // the gradient points from x to the anchor: C = |x - anchor|
+    const tReal dlambda = (c - alpha_tilda*lambda) / (w + alpha_tilda);
+    lambda += dlambda;
+    x -= w_x*dlambda*n;
+    applyImpulse(b, r, dlambda*n);
+  }
+
+  // Box corners against the ground plane, with static friction that undoes
+  // the tangential motion of the corner over the step
+  void collideFloor()
+  {
+    for(tUint b = 0; b < size(); ++b) {
+      if(_inv_mass[b] == 0.f)
+        continue;
+      for(int k = 0; k < 8; ++k) {
+        const glm::vec3 corner(k & 1 ? 1.f : -1.f, k & 2 ? 1.f : -1.f, k & 4 ? 1.f : -1.f);
+        const glm::vec3 local = corner*_half[b];
+        const glm::vec3 r = _q[b]*local;
+        const glm::vec3 x = _p[b] + r;
+        const tReal depth = _prm.floor - x[1];
+        if(depth <= 0.f)
+          continue;
+        tReal lambda_n = 0.f;
+        applyPositional(b, r, kWorld, glm::vec3(0.f), glm::vec3(0.f, depth, 0.f), 0.f, lambda_n);
+
+        const glm::vec3 r_now = _q[b]*local;
+        const glm::vec3 x_prev = _p_prev[b] + _q_prev[b]*local;
+        glm::vec3 slip = _p[b] + r_now - x_prev;
+        slip[1] = 0.f;
+        const tReal len = glm::length(slip);
+        if(len > 1e-7f) {
+          tReal lambda_t = 0.f;
+          applyPositional(b, r_now, kWorld, glm::vec3(0.f),
+                          -std::min(len, _prm.friction*depth)/len*slip, 0.f, lambda_t);
+        }
+      }
+    }
+  }
+
+  // Particles inside a box are pushed out through the face they entered by,
+  // or the nearest one, and static friction cancels their relative sliding
+  // over the step. The box receives the average of the opposite corrections:
+  // resolving many simultaneous contacts of one body one after the other
+  // spins it instead of lifting it. The bodies run in parallel, each on the
+  // particles of the grid cells around it; the particle corrections are then
+  // added in the order of the bodies.
+  void collideParticles(
+    std::vector<glm::vec3> &x, const std::vector<glm::vec3> &x_prev, const std::vector<tReal> &w)
+  {
+    const int nb = size();
+    if(nb == 0 || x.empty())
+      return;
+    const tReal d = _prm.cloth_thickness;
+    tReal cell = 1e-6f;         // the bounding radius of every body, for forEachInBox()
+    for(int b = 0; b < nb; ++b)
+      cell = std::max(cell, glm::length(_half[b] + d));
+    _particle_grid.build(x, cell);
+    _particle_contacts.resize(nb);
+
+#pragma omp parallel for schedule(dynamic)
+    for(int b = 0; b < nb; ++b) {
+      const glm::vec3 h = _half[b] + d;
+      const tReal bound2 = glm::dot(h, h);
+      const bool dynamic = _inv_mass[b] > 0.f;
+      glm::vec3 dp(0.f), dtheta(0.f);
+
+      // candidates in index order, so that the sums do not depend on the grid
+      std::vector<ParticleContact> &contacts = _particle_contacts[b];
+      contacts.clear();
+      _particle_grid.forEachInBox(_p[b], std::sqrt(bound2), [&](const tUint i) {
+        const glm::vec3 r = x[i] - _p[b];
+        if(glm::dot(r, r) <= bound2)
+          contacts.push_back(ParticleContact{i, glm::vec3(0.f)});
+      });
+      std::sort(contacts.begin(), contacts.end(),
+                [](const ParticleContact &c1, const ParticleContact &c2) { return c1.i < c2.i; });
+
+      int num_contacts = 0;
+      for(ParticleContact &contact : contacts) {
+        const tUint i = contact.i;
+        const glm::vec3 r = x[i] - _p[b];
+        const glm::vec3 l = glm::conjugate(_q[b])*r;
+        const glm::vec3 gap = h - glm::abs(l);
+        if(gap[0] <= 0.f || gap[1] <= 0.f || gap[2] <= 0.f)
+          continue;
+
+        const glm::vec3 l_prev = glm::conjugate(_q_prev[b])*(x_prev[i] - _p_prev[b]);
+        int a = -1;
+        for(int k = 0; k < 3; ++k)
+          if(std::abs(l_prev[k]) >= h[k] && (a < 0 || gap[k] < gap[a]))
+            a = k;
+        if(a < 0)
+          a = gap[0] < gap[1] ? (gap[0] < gap[2] ? 0 : 2) : (gap[1] < gap[2] ? 1 : 2);
+        glm::vec3 n_local(0.f);
+        n_local[a] = l[a] < 0.f ? -1.f : 1.f;
+        const glm::vec3 n = _q[b]*n_local;
+
+        // relative sliding of the particle on the box over the step
+        const glm::vec3 body_prev = _p_prev[b] + _q_prev[b]*l;
+        glm::vec3 slip = (x[i] - x_prev[i]) - (_p[b] + r - body_prev);
+        slip -= glm::dot(slip, n)*n;
+        const tReal slip_len = glm::length(slip);
+        const tReal stick = slip_len > 1e-7f ? std::min(slip_len, _prm.friction*gap[a])/slip_len : 0.f;
+
+        // the particle moves by gap along n and back along the slip; both
+        // corrections are split by the generalized inverse masses
+        const glm::vec3 corr[2] = {gap[a]*n, -stick*slip};
+        for(int k = 0; k < 2; ++k) {
+          const tReal c = glm::length(corr[k]);
+          if(c < 1e-7f)
+            continue;
+          const glm::vec3 dir = corr[k]/c;
+          const tReal w_sum = w[i] + generalizedInvMass(b, r, dir);
+          if(w_sum < 1e-12f)
+            continue;
+          const glm::vec3 impulse = c/w_sum*dir;
+          contact.dx += w[i]*impulse;
+          if(dynamic) {
+            dp -= _inv_mass[b]*impulse;
+            dtheta -= applyInvInertia(b, glm::cross(r, impulse));
+          }
+        }
+        ++num_contacts;
+      }
+
+      if(dynamic && num_contacts > 0) {
+        _p[b] += dp/tReal(num_contacts);
+        integrateRotation(b, dtheta/tReal(num_contacts));
+      }
+    }
+
+    for(int b = 0; b < nb; ++b)
+      for(const ParticleContact &contact : _particle_contacts[b])
+        x[contact.i] += contact.dx;
+  }
+
+  RigidParams _prm;
+
+  // bodies
+  std::vector<glm::vec3> _p, _p_prev, _v, _omega;
+  std::vector<glm::quat> _q, _q_prev;
+  std::vector<tReal> _inv_mass;
+  std::vector<glm::vec3> _inv_inertia; // diagonal, in the body frame
+  std::vector<glm::vec3> _half;        // half extents of the box
+
+  // joints; anchors and axes in the frame of each body
+  std::vector<int> _joint_b1, _joint_b2;
+  std::vector<glm::vec3> _joint_r1, _joint_r2, _joint_a1, _joint_a2;
+  std::vector<bool> _joint_hinge;
+  std::vector<tReal> _joint_alpha, _joint_lambda_pos, _joint_lambda_ang;
+
+  // particle attachments
+  std::vector<tUint> _att_particle;
+  std::vector<int> _att_body;
+  std::vector<glm::vec3> _att_r;
+  std::vector<tReal> _att_alpha, _att_lambda;
+  // particle contacts, scratch of collideParticles()
+  struct ParticleContact {
+    tUint i;
+    glm::vec3 dx;               // correction of the particle
+  };
+  NeighborGrid _particle_grid;
+  std::vector<std::vector<ParticleContact>> _particle_contacts; // per body
+};
+
+#endif  /* _RIGIDBODIES_HPP_ */
@@ -0,0 +1,79 @@
+// ----------------------------------------------------------------------------
+// Scenes.hpp
+//
+// Description: Content of the demo scene, without OpenGL, so that the viewer
+//              and xpbd_sim simulate the same thing
+// ----------------------------------------------------------------------------
+
+#ifndef _SCENES_HPP_
+#define _SCENES_HPP_
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+#include "TetMesh.h"
+#include "PbfFluid.hpp"
+#include "RigidBodies.hpp"
+#include "ShapeMatching.hpp"
+
+// The cloth laid on the table of sceneClothPins()
+inline void addSceneCloth(MeshData &cloth)
+{
+  cloth.addCloth(15, 30, 0.6f, 1.2f);
+  // cloth.addCloth(30, 15, 1.2f, 0.6f);
+  // cloth.addCube(0.5f);
+}
+
+// Vertices of the cloth of addSceneCloth() lying on the table, to be pinned
+// by PbdSolver::initSim()
+inline std::vector<tUint> sceneClothPins()
+{
+  std::vector<tUint> pins;
+  for(int i = 0; i < 16; ++i) {
+    for(int j = 0; j < 9; ++j)
+      pins.push_back(30*(3 + j) + i + 7);
+  }
+  return pins;
+}
+
+// Shape-matching clusters stiffening the hanging end of the cloth of
+// addSceneCloth(), given its vertices
+inline std::vector<std::vector<tUint>> sceneStiffPatch(const std::vector<glm::vec3> &cloth)
+{
+  return clustersInRegion(cloth, glm::vec3(-0.3f, -0.1f, 0.4f), glm::vec3(0.3f, 0.1f, 0.6f), 0.1f);
+}
+
+// The soft body, instead of the cloth
+inline void addSceneSoftBody(TetMesh &body)
+{
+  body.addBox(0.5f, 0.5f, 0.5f, 6, 6, 6);
+}
+
+// A block of liquid poured over the scene
+inline std::shared_ptr<PbfFluid> makeSceneFluid()
+{
+  std::shared_ptr<PbfFluid> fluid = std::make_shared<PbfFluid>();
+  fluid->addBlock(glm::vec3(-0.15f, 0.2f, -0.15f), glm::vec3(0.15f, 0.5f, 0.15f));
+  return fluid;
+}
+
+// A hinged chain holding the free corner of the cloth of addSceneCloth(), and
+// a box dropped on the table
+inline std::shared_ptr<RigidBodies> makeSceneProps()
+{
+  std::shared_ptr<RigidBodies> props = std::make_shared<RigidBodies>();
+  const glm::vec3 top(0.3f, 0.6f, 0.6f);
+  int link = RigidBodies::kWorld;
+  for(int k = 0; k < 3; ++k) {
+    const int next = props->addBox(top - glm::vec3(0.f, 0.1f + 0.2f*k, 0.f), glm::vec3(0.02f, 0.1f, 0.02f), 500.f);
+    props->addHingeJoint(link, next, top - glm::vec3(0.f, 0.2f*k, 0.f), glm::vec3(1.f, 0.f, 0.f));
+    link = next;
+  }
+  props->attachParticle(449, link, top - glm::vec3(0.f, 0.6f, 0.f));
+  props->addBox(glm::vec3(0.f, 0.4f, -0.1f), glm::vec3(0.08f), 500.f);
+  return props;
+}
+
+#endif  /* _SCENES_HPP_ */
@@ -4,8 +4,36 @@
 #include <fstream>
 #include <sstream>
 
+#include <cstring>
 #include <exception>
 #include <ios>
+#include <stdexcept>
+#include <vector>
+
+#include "BinaryCache.h"
+
+namespace {
+
+const std::uint64_t kProgramCacheSeed = 1; // to change with the layout of the cache
+
+// OpenGL 4.1, missing from glad for OpenGL 3.3
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+std::string binaryCacheDirectory;
+
+GetProgramBinaryProc glGetProgramBinary_ = nullptr;
+ProgramBinaryProc glProgramBinary_ = nullptr;
+ProgramParameteriProc glProgramParameteri_ = nullptr;
+
+} // namespace
 
 // Create a GPU program i.e., a graphics pipeline
 ShaderProgram::ShaderProgram() : _id(glCreateProgram()) {}
@@ -27,39 +55,198 @@ std::string ShaderProgram::file2String(const std::string &filename)
 
 void ShaderProgram::loadShader(GLenum type, const std::string &shaderFilename)
 {
-  // Loads and compile a shader, before attaching it to a program
-  GLuint shader = glCreateShader(type); // Create the shader, e.g., a vertex shader to be applied to every single vertex of a mesh
-  std::string shaderSourceString = file2String(shaderFilename); // Loads the shader source from a file to a C++ string
-  if(shaderSourceString.empty()) {
+  Source source = {type, shaderFilename, file2String(shaderFilename)}; // Loads the shader source from a file to a C++ string
+  if(source.text.empty()) {
     std::cerr << "No content in shader " << shaderFilename << std::endl;
-    glDeleteShader(shader);
     return;
   }
-  const GLchar *shaderSource = (const GLchar *) shaderSourceString.c_str(); // Interface the C++ string through a C pointer
-  glShaderSource(shader, 1, &shaderSource, NULL); // Load the vertex shader source code
-  glCompileShader(shader);      // THe GPU driver compile the shader
-  GLint compiled;
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-  if(!compiled) {
-    GLsizei len;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
-    GLchar *log = new GLchar[len+1];
-    glGetShaderInfoLog(shader, len, &len, log);
-    std::cerr << "Compilation error in shader " << shaderFilename << " : " << std::endl << log << std::endl;
-    delete [] log;
-    glDeleteShader(shader);
+  _sources.push_back(source);
+}
+
+void ShaderProgram::link()
+{
+  if(!loadBinary()) {
+    for(const Source &source : _sources) {
+      // Compile the shader, before attaching it to the program
+      GLuint shader = glCreateShader(source.type); // Create the shader, e.g., a vertex shader to be applied to every single vertex of a mesh
+      const GLchar *shaderSource = (const GLchar *) source.text.c_str(); // Interface the C++ string through a C pointer
+      glShaderSource(shader, 1, &shaderSource, NULL); // Load the vertex shader source code
+      glCompileShader(shader);  // THe GPU driver compile the shader
+      GLint compiled;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+      if(!compiled) {
+        GLsizei len;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+        GLchar *log = new GLchar[len+1];
+        glGetShaderInfoLog(shader, len, &len, log);
+        std::cerr << "Compilation error in shader " << source.filename << " : " << std::endl << log << std::endl;
+        delete [] log;
+        glDeleteShader(shader);
+        continue;               // reported again by the link
+      }
+      glAttachShader(_id, shader); // Set the vertex shader as the one ot be used with the program/pipeline
+      glDeleteShader(shader);
+    }
+    if(!_binaryCache.empty() && glProgramParameteri_)
+      glProgramParameteri_(_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(_id);
+
+    GLint linked;
+    glGetProgramiv(_id, GL_LINK_STATUS, &linked);
+    if(!linked) {
+      GLsizei len;
+      glGetProgramiv(_id, GL_INFO_LOG_LENGTH, &len);
+      std::vector<GLchar> log(len + 1, 0);
+      glGetProgramInfoLog(_id, len, &len, log.data());
+      std::string shaders;
+      for(const Source &source : _sources)
+        shaders += " " + source.filename;
+      throw std::runtime_error("[Shader Program][link] Link error in program of" + shaders + " :\n" + log.data());
+    }
+    saveBinary();
+  }
+  _sources.clear();
+  cacheLocations();
+}
+
+std::uint64_t ShaderProgram::binaryKey() const
+{
+  std::string driver;
+  for(const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const GLubyte *s = glGetString(name);
+    driver += s ? reinterpret_cast<const char *>(s) : "";
+    driver += '\n';
+  }
+  std::uint64_t key = hashBytes(driver.data(), driver.size(), kProgramCacheSeed);
+  for(const Source &source : _sources) {
+    key = hashBytes(&source.type, sizeof(source.type), key);
+    key = hashBytes(source.text.data(), source.text.size(), key);
+  }
+  return key;
+}
+
+bool ShaderProgram::loadBinary()
+{
+  if(_binaryCache.empty() || !glProgramBinary_)
+    return false;
+  CacheReader reader;
+  std::vector<GLenum> format;
+  std::vector<char> binary;
+  if(!reader.open(_binaryCache, binaryKey()) ||
+     !reader.read(cacheTag("FMT "), format) || format.size() != 1 || !reader.read(cacheTag("PBIN"), binary))
+    return false;
+  glProgramBinary_(_id, format[0], binary.data(), binary.size());
+  GLint linked;
+  glGetProgramiv(_id, GL_LINK_STATUS, &linked);
+  return linked == GL_TRUE;     // else rejected by the driver, e.g. after an update: compile
+}
+
+void ShaderProgram::saveBinary() const
+{
+  if(_binaryCache.empty() || !glGetProgramBinary_)
+    return;
+  GLint length = 0;
+  glGetProgramiv(_id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if(length <= 0)
     return;
+  std::vector<GLenum> format(1);
+  std::vector<char> binary(length);
+  glGetProgramBinary_(_id, length, &length, format.data(), binary.data());
+  binary.resize(length);
+  CacheWriter writer;
+  writer.add(cacheTag("FMT "), format);
+  writer.add(cacheTag("PBIN"), binary);
+  writer.write(_binaryCache, binaryKey()); // best effort, the directory may be read-only
+}
+
+void ShaderProgram::cacheLocations()
+{
+  _locations.clear();
+  GLint count = 0, maxLength = 0;
+  glGetProgramiv(_id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<GLchar> name(maxLength + 1);
+  for(GLint u = 0; u < count; ++u) {
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(_id, u, name.size(), NULL, &size, &type, name.data());
+    const GLint location = glGetUniformLocation(_id, name.data());
+    if(location < 0)            // member of a uniform block
+      continue;
+    std::string uniform(name.data());
+    if(uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+      // an array: its name alone is its first element, the others follow
+      uniform.resize(uniform.size() - 3);
+      for(GLint k = 1; k < size; ++k) {
+        const std::string element = uniform + "[" + std::to_string(k) + "]";
+        _locations[element] = glGetUniformLocation(_id, element.c_str());
+      }
+      _locations[uniform + "[0]"] = location;
+    }
+    _locations[uniform] = location;
   }
-  glAttachShader(_id, shader); // Set the vertex shader as the one ot be used with the program/pipeline
-  glDeleteShader(shader);
 }
 
+void ShaderProgram::setBinaryCacheDirectory(const std::string &directory)
+{
+  binaryCacheDirectory = directory;
+  if(!directory.empty() && !makeDirectories(directory)) {
+    std::cerr << "[ShaderProgram][setBinaryCacheDirectory] Warning: cannot create " << directory
+              << ", the programs are not cached" << std::endl;
+    binaryCacheDirectory.clear();
+  }
+}
+
+std::string ShaderProgram::binaryCacheFile(const std::string &shaderFilename)
+{
+  if(binaryCacheDirectory.empty())
+    return std::string();
+  const std::size_t slash = shaderFilename.find_last_of("/\\");
+  const std::string name = slash == std::string::npos ? shaderFilename : shaderFilename.substr(slash + 1);
+  return binaryCacheDirectory + "/" + name + ".xprog";
+}
+
+void ShaderProgram::loadBinaryFunctions(GLADloadproc load)
+{
+  glGetProgramBinary_ = nullptr;
+  glProgramBinary_ = nullptr;
+  glProgramParameteri_ = nullptr;
+  GLint major = 0, minor = 0, numFormats = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  bool supported = major > 4 || (major == 4 && minor >= 1);
+  GLint numExtensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+  for(GLint e = 0; e < numExtensions && !supported; ++e)
+    supported = std::strcmp(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, e)), "GL_ARB_get_program_binary") == 0;
+  if(!supported)
+    return;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  if(numFormats == 0)           // the driver cannot save programs
+    return;
+  glGetProgramBinary_ = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+  glProgramBinary_ = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+  glProgramParameteri_ = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+  if(!glGetProgramBinary_ || !glProgramBinary_ || !glProgramParameteri_) {
+    glGetProgramBinary_ = nullptr;
+    glProgramBinary_ = nullptr;
+    glProgramParameteri_ = nullptr;
+  }
+}
+
+void ShaderProgram::bindUniformBlock(const std::string &name, GLuint binding)
+{
+  const GLuint block = glGetUniformBlockIndex(_id, name.c_str());
+  if(block != GL_INVALID_INDEX)
+    glUniformBlockBinding(_id, block, binding);
+}
 
 std::shared_ptr<ShaderProgram> ShaderProgram::genBasicShaderProgram(
   const std::string &vertexShaderFilename,
   const std::string &fragmentShaderFilename)
 {
   std::shared_ptr<ShaderProgram> shaderProgramPtr = std::make_shared<ShaderProgram>();
+  shaderProgramPtr->setBinaryCache(binaryCacheFile(vertexShaderFilename));
   shaderProgramPtr->loadShader(GL_VERTEX_SHADER, vertexShaderFilename);
   shaderProgramPtr->loadShader(GL_FRAGMENT_SHADER, fragmentShaderFilename);
   shaderProgramPtr->link();
@@ -2,8 +2,11 @@
 #define SHADER_PROGRAM_H
 
 #include <glad/glad.h>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
@@ -13,18 +16,38 @@ public:
   ShaderProgram();
   virtual ~ShaderProgram();
 
-  // Generate a minimal shader program, made of one vertex shader and one fragment shader
+  // Generate a minimal shader program, made of one vertex shader and one
+  // fragment shader, cached as the binary of the vertex shader
   static std::shared_ptr<ShaderProgram> genBasicShaderProgram(
     const std::string &vertexShaderFilename, const std::string &fragmentShaderFilename);
 
+  // Program binaries (OpenGL 4.1 or ARB_get_program_binary) are not in the
+  // bundled glad: loads their entry points, once the context is current, if
+  // the driver has them. Without them, programs are always compiled.
+  static void loadBinaryFunctions(GLADloadproc load);
+
+  // Program binaries go to directory, created if needed; none are cached
+  // until it is set, nor if it cannot be created
+  static void setBinaryCacheDirectory(const std::string &directory);
+
+  // <directory>/<name of shaderFilename>.xprog, empty without a directory
+  static std::string binaryCacheFile(const std::string &shaderFilename);
+
   // OpenGL identifier of the program
   GLuint id() const { return _id; }
 
-  // Loads and compile a shader from a text file, before attaching it to a program
+  // Loads a shader from a text file; link() compiles it and attaches it to
+  // the program, unless the program comes from its binary cache
   void loadShader(GLenum type, const std::string &shaderFilename);
 
-  // The main GPU program is ready to be handle streams of polygons
-  void link() { glLinkProgram(_id); }
+  // The binary of the linked program is saved to filename and reused by the
+  // next link() of the same sources on the same driver
+  void setBinaryCache(const std::string &filename) { _binaryCache = filename; }
+
+  // The main GPU program is ready to be handle streams of polygons; the
+  // locations of its active uniforms are then looked up once and cached.
+  // Throws std::runtime_error, with the log of the driver, if linking fails.
+  void link();
 
   // Activate the program
   void use() { glUseProgram(_id); }
@@ -32,51 +55,52 @@ public:
   // Desactivate the current program
   static void stop() { glUseProgram(0); }
 
-  GLuint getLocation(const std::string &name) const
-  {
-    return glGetUniformLocation(_id, name.c_str());
-  }
-
-  void set(const std::string &name, int value)
-  {
-    glUniform1i(getLocation(name.c_str()), value);
-  }
-
-  void set(const std::string &name, float value)
-  {
-    glUniform1f(getLocation(name.c_str()), value);
-  }
-
-  void set(const std::string &name, const glm::vec2 &value)
-  {
-    glUniform2fv(getLocation(name.c_str()), 1, glm::value_ptr(value));
-  }
-
-  void set(const std::string &name, const glm::vec3 &value)
-  {
-    glUniform3fv(getLocation(name.c_str()), 1, glm::value_ptr(value));
-  }
-
-  void set(const std::string &name, const glm::vec4 &value)
-  {
-    glUniform4fv(getLocation(name.c_str()), 1, glm::value_ptr(value));
-  }
-
-  void set(const std::string &name, const glm::mat4 &value)
+  // Location of an active uniform, -1 if there is none of that name. Uniforms
+  // of blocks have none; they are set through their UniformBuffer.
+  GLint getLocation(const std::string &name) const
   {
-    glUniformMatrix4fv(getLocation(name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    const auto it = _locations.find(name);
+    return it == _locations.end() ? -1 : it->second;
   }
 
-  void set(const std::string &name, const glm::mat3 &value)
+  // Reads the uniform block `name` from the uniform buffer bound to binding
+  void bindUniformBlock(const std::string &name, GLuint binding);
+
+  // By location, for the uniforms set for every object drawn
+  void set(GLint location, int value) { glUniform1i(location, value); }
+  void set(GLint location, GLuint value) { glUniform1ui(location, value); }
+  void set(GLint location, float value) { glUniform1f(location, value); }
+  void set(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, glm::value_ptr(value)); }
+  void set(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, glm::value_ptr(value)); }
+  void set(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, glm::value_ptr(value)); }
+  void set(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+  void set(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+
+  template<typename T>
+  void set(const std::string &name, const T &value)
   {
-    glUniformMatrix3fv(getLocation(name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    set(getLocation(name), value);
   }
 
 private:
+  struct Source {
+    GLenum type;
+    std::string filename, text;
+  };
+
   // Loads the content of an ASCII file in a standard C++ string
   std::string file2String(const std::string &filename);
 
+  // Key of the binary cache: the sources and the driver
+  std::uint64_t binaryKey() const;
+  bool loadBinary();
+  void saveBinary() const;
+  void cacheLocations();
+
   GLuint _id = 0;
+  std::vector<Source> _sources; // until link()
+  std::string _binaryCache;
+  std::unordered_map<std::string, GLint> _locations; // of the active uniforms, filled by link()
 };
 
 #endif  // SHADER_PROGRAM_H
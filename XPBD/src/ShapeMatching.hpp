@@ -0,0 +1,248 @@
+// ----------------------------------------------------------------------------
+// ShapeMatching.hpp
+//
+// Description: Shape-matching constraint groups [Muller et al. 2005] for rigid
+//              and plastic clusters of vertices
+// ----------------------------------------------------------------------------
+
+#ifndef _SHAPEMATCHING_HPP_
+#define _SHAPEMATCHING_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "Coloring.hpp"
+
+struct ShapeMatchingParams {
+  tReal stiffness = 1.f;        // fraction of the way to the goal after all iterations, in [0,1]
+  tReal plastic_yield = 0.f;    // relative deviation above which the rest shape creeps; 0 disables plasticity
+  tReal plastic_creep = 0.1f;   // fraction of the deviation absorbed per step
+  tReal plastic_max = 0.5f;     // maximal accumulated plastic strain
+};
+
+// Clusters of the vertices inside [lo, hi]: overlapping cubes of side 2*size
+// centered every `size`, so that neighbouring clusters share vertices. A size
+// of zero or larger than the region gives a single cluster.
+inline std::vector<std::vector<tUint>> clustersInRegion(
+  const std::vector<glm::vec3> &x, const glm::vec3 &lo, const glm::vec3 &hi, const tReal size)
+{
+  const glm::vec3 ext = hi - lo;
+  const tReal s = (size <= 0.f) ? std::max(ext[0], std::max(ext[1], ext[2])) : size;
+  const glm::ivec3 n = glm::max(glm::ivec3(glm::ceil(ext/s)), glm::ivec3(1));
+
+  std::vector<std::vector<tUint>> clusters;
+  for(int i = 0; i < n[0]; ++i) {
+    for(int j = 0; j < n[1]; ++j) {
+      for(int k = 0; k < n[2]; ++k) {
+        const glm::vec3 c = lo + s*(glm::vec3(i, j, k) + 0.5f);
+        std::vector<tUint> ids;
+        for(tUint v = 0; v < x.size(); ++v) {
+          if(glm::all(glm::greaterThanEqual(x[v], lo)) && glm::all(glm::lessThanEqual(x[v], hi)) &&
+             glm::all(glm::lessThanEqual(glm::abs(x[v] - c), glm::vec3(s))))
+            ids.push_back(v);
+        }
+        if(ids.size() > 1)
+          clusters.push_back(ids);
+      }
+    }
+  }
+  return clusters;
+}
+
+// stands for the infinite mass of pinned vertices in the centers of mass
+const tReal kPinnedMass = 1e4f;
+
+// A set of shape-matching clusters sharing the same parameters. Per-cluster
+// state is stored SoA so that the polar decompositions of all the clusters
+// run as one vectorizable loop; clusters are coloured so that the goal
+// projections of one colour can run in parallel.
+struct ShapeMatchingBatch {
+  void build(
+    const std::vector<std::vector<tUint>> &clusters,
+    const std::vector<glm::vec3> &x, const std::vector<tReal> &w,
+    const ShapeMatchingParams &params)
+  {
+    _params = params;
+
+    std::vector<tUint> offsets(1, 0), ids, color, perm;
+    for(const auto &c : clusters) {
+      ids.insert(ids.end(), c.begin(), c.end());
+      offsets.push_back(ids.size());
+    }
+    const tUint num_colors = colorElements(offsets, ids, x.size(), color);
+    sortByColor(color, num_colors, perm, _color_offsets);
+
+    const tUint n = clusters.size();
+    _offsets.assign(1, 0);
+    _ids.clear();
+    _m.clear();
+    _q.clear();
+    for(tUint s = 0; s < n; ++s) {
+      const auto &c = clusters[perm[s]];
+      glm::vec3 center(0.f);
+      tReal mass = 0.f;
+      for(tUint v : c) {
+        const tReal m = (w[v] > 0.f) ? 1.f/w[v] : kPinnedMass;
+        center += m*x[v];
+        mass += m;
+      }
+      center /= mass;
+      for(tUint v : c) {
+        _ids.push_back(v);
+        _m.push_back(((w[v] > 0.f) ? 1.f/w[v] : kPinnedMass) / mass); // normalized
+        _q.push_back(x[v] - center);
+      }
+      _offsets.push_back(_ids.size());
+    }
+
+    for(int k = 0; k < 3; ++k) _c[k].assign(n, 0.f);
+    for(int k = 0; k < 9; ++k) _A[k].assign(n, 0.f);
+    _rot[0].assign(n, 0.f); _rot[1].assign(n, 0.f); _rot[2].assign(n, 0.f); _rot[3].assign(n, 1.f);
+    _plastic.assign(n, 0.f);
+  }
+
+  tUint size() const { return _rot[3].size(); }
+
+  // Called once per step, after the iterations
+  void updatePlasticity(const std::vector<glm::vec3> &x)
+  {
+    if(_params.plastic_yield <= 0.f)
+      return;
+    computeMoments(x);
+    extractRotations(kRotationIterations);
+
+#pragma omp parallel for
+    for(int s = 0; s < (int)size(); ++s) {
+      const glm::mat3 Rt = glm::transpose(rotation(s));
+      const glm::vec3 c(_c[0][s], _c[1][s], _c[2][s]);
+      tReal dev = 0.f, ref = 0.f;
+      for(tUint k = _offsets[s]; k < _offsets[s+1]; ++k) {
+        const glm::vec3 d = Rt*(x[_ids[k]] - c) - _q[k];
+        dev += _m[k]*glm::dot(d, d);
+        ref += _m[k]*glm::dot(_q[k], _q[k]);
+      }
+      const tReal strain = std::sqrt(dev / std::max(ref, 1e-12f));
+      if(strain <= _params.plastic_yield || _plastic[s] >= _params.plastic_max)
+        continue;
+
+      const tReal creep = std::min(_params.plastic_creep, (_params.plastic_max - _plastic[s]) / strain);
+      glm::vec3 shift(0.f);
+      for(tUint k = _offsets[s]; k < _offsets[s+1]; ++k) {
+        _q[k] += creep*(Rt*(x[_ids[k]] - c) - _q[k]);
+        shift += _m[k]*_q[k];
+      }
+      for(tUint k = _offsets[s]; k < _offsets[s+1]; ++k)
+        _q[k] -= shift;         // keep the rest shape centered
+      _plastic[s] += creep*strain;
+    }
+  }
+
+  // One goal projection of every cluster; num_iterations makes the stiffness
+  // independent of the solver iteration count
+  void project(std::vector<glm::vec3> &x, const std::vector<tReal> &w, const tUint num_iterations)
+  {
+    computeMoments(x);
+    extractRotations(kRotationIterations);
+
+    const tReal k = 1.f - std::pow(1.f - std::min(_params.stiffness, 1.f), 1.f/num_iterations);
+    for(tUint col = 0; col + 1 < _color_offsets.size(); ++col) {
+      const int begin = _color_offsets[col], end = _color_offsets[col+1];
+      // no two clusters of a colour share a vertex
+#pragma omp parallel for
+      for(int s = begin; s < end; ++s) {
+        const glm::mat3 R = rotation(s);
+        const glm::vec3 c(_c[0][s], _c[1][s], _c[2][s]);
+        for(tUint j = _offsets[s]; j < _offsets[s+1]; ++j) {
+          const tUint v = _ids[j];
+          if(w[v] > 0.f)
+            x[v] += k*(R*_q[j] + c - x[v]);
+        }
+      }
+    }
+  }
+
+private:
+  // Centers of mass and moment matrices A_pq = sum m (x - c) q^T
+  void computeMoments(const std::vector<glm::vec3> &x)
+  {
+#pragma omp parallel for
+    for(int s = 0; s < (int)size(); ++s) {
+      glm::vec3 c(0.f);
+      for(tUint k = _offsets[s]; k < _offsets[s+1]; ++k)
+        c += _m[k]*x[_ids[k]];
+      glm::mat3 A(0.f);
+      for(tUint k = _offsets[s]; k < _offsets[s+1]; ++k)
+        A += glm::outerProduct(_m[k]*(x[_ids[k]] - c), _q[k]);
+      for(int d = 0; d < 3; ++d) _c[d][s] = c[d];
+      for(int d = 0; d < 9; ++d) _A[d][s] = A[d/3][d%3];
+    }
+  }
+
+  // Rotational part of every A_pq [Muller et al. 2016, "A robust method to
+  // extract the rotational part of deformations"], warm-started from the
+  // previous rotation. Written on scalars over the SoA arrays so that the loop
+  // over clusters vectorizes.
+  void extractRotations(const int iterations)
+  {
+    const int n = size();
+    tReal *qx = _rot[0].data(), *qy = _rot[1].data(), *qz = _rot[2].data(), *qw = _rot[3].data();
+    const tReal *a0 = _A[0].data(), *a1 = _A[1].data(), *a2 = _A[2].data();
+    const tReal *a3 = _A[3].data(), *a4 = _A[4].data(), *a5 = _A[5].data();
+    const tReal *a6 = _A[6].data(), *a7 = _A[7].data(), *a8 = _A[8].data();
+    for(int it = 0; it < iterations; ++it) {
+#pragma omp parallel for simd
+      for(int s = 0; s < n; ++s) {
+        const tReal x = qx[s], y = qy[s], z = qz[s], r = qw[s];
+        // columns of the rotation matrix of (x, y, z, r)
+        const tReal r0x = 1.f - 2.f*(y*y + z*z), r0y = 2.f*(x*y + r*z), r0z = 2.f*(x*z - r*y);
+        const tReal r1x = 2.f*(x*y - r*z), r1y = 1.f - 2.f*(x*x + z*z), r1z = 2.f*(y*z + r*x);
+        const tReal r2x = 2.f*(x*z + r*y), r2y = 2.f*(y*z - r*x), r2z = 1.f - 2.f*(x*x + y*y);
+        // omega = sum_i r_i x a_i / (|sum_i r_i . a_i| + eps)
+        const tReal ox = (r0y*a2[s] - r0z*a1[s]) + (r1y*a5[s] - r1z*a4[s]) + (r2y*a8[s] - r2z*a7[s]);
+        const tReal oy = (r0z*a0[s] - r0x*a2[s]) + (r1z*a3[s] - r1x*a5[s]) + (r2z*a6[s] - r2x*a8[s]);
+        const tReal oz = (r0x*a1[s] - r0y*a0[s]) + (r1x*a4[s] - r1y*a3[s]) + (r2x*a7[s] - r2y*a6[s]);
+        const tReal dot = r0x*a0[s] + r0y*a1[s] + r0z*a2[s] + r1x*a3[s] + r1y*a4[s] + r1z*a5[s] +
+                          r2x*a6[s] + r2y*a7[s] + r2z*a8[s];
+        const tReal inv = 1.f / (std::fabs(dot) + 1e-9f);
+        // q <- (omega/2, 1) * q: the rotation by |omega| up to second order,
+        // which has the same fixed point and needs neither trigonometry nor branches
+        const tReal dx = 0.5f*ox*inv, dy = 0.5f*oy*inv, dz = 0.5f*oz*inv, dw = 1.f;
+        const tReal nx = dw*x + dx*r + dy*z - dz*y;
+        const tReal ny = dw*y - dx*z + dy*r + dz*x;
+        const tReal nz = dw*z + dx*y - dy*x + dz*r;
+        const tReal nw = dw*r - dx*x - dy*y - dz*z;
+        const tReal norm = 1.f / std::sqrt(nx*nx + ny*ny + nz*nz + nw*nw);
+        qx[s] = nx*norm; qy[s] = ny*norm; qz[s] = nz*norm; qw[s] = nw*norm;
+      }
+    }
+  }
+
+  glm::mat3 rotation(const int s) const
+  {
+    const tReal x = _rot[0][s], y = _rot[1][s], z = _rot[2][s], r = _rot[3][s];
+    return glm::mat3(
+      1.f - 2.f*(y*y + z*z), 2.f*(x*y + r*z), 2.f*(x*z - r*y),
+      2.f*(x*y - r*z), 1.f - 2.f*(x*x + z*z), 2.f*(y*z + r*x),
+      2.f*(x*z + r*y), 2.f*(y*z - r*x), 1.f - 2.f*(x*x + y*y));
+  }
+
+  static const int kRotationIterations = 3;
+
+  ShapeMatchingParams _params;
+
+  std::vector<tUint> _offsets;  // members of cluster s: [_offsets[s], _offsets[s+1])
+  std::vector<tUint> _ids;      // member vertex ids
+  std::vector<tReal> _m;        // member masses, normalized per cluster
+  std::vector<glm::vec3> _q;    // member rest positions relative to the rest center
+
+  std::vector<tReal> _c[3];     // current centers of mass
+  std::vector<tReal> _A[9];     // moment matrices, column-major
+  std::vector<tReal> _rot[4];   // rotations as quaternions (x, y, z, w)
+  std::vector<tReal> _plastic;  // accumulated plastic strain
+  std::vector<tUint> _color_offsets; // clusters of colour c: [_color_offsets[c], _color_offsets[c+1])
+};
+
+#endif  /* _SHAPEMATCHING_HPP_ */
@@ -0,0 +1,175 @@
+// ----------------------------------------------------------------------------
+// SparseCholesky.hpp
+//
+// Description: Sparse LDL^T factorization of symmetric positive definite
+//              matrices, after the LDL package of T. Davis, with reverse
+//              Cuthill-McKee ordering
+// ----------------------------------------------------------------------------
+
+#ifndef _SPARSECHOLESKY_HPP_
+#define _SPARSECHOLESKY_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+
+// Matrices are given in CSR form with the full symmetric pattern, and every
+// row holding its diagonal entry. analyze() depends on the pattern only, so
+// factor() can be repeated for new values of the same pattern.
+class SparseLDLT {
+public:
+  tUint size() const { return _n; }
+  bool factored() const { return _factored; }
+
+  void analyze(const tUint n, const std::vector<tUint> &Ap, const std::vector<tUint> &Ai)
+  {
+    _n = n;
+    _factored = false;
+    orderRCM(Ap, Ai);
+
+    // elimination tree and column counts of L
+    const int none = -1;
+    _parent.assign(n, none);
+    std::vector<int> flag(n);
+    std::vector<tUint> lnz(n, 0);
+    for(tUint k = 0; k < n; ++k) {
+      flag[k] = k;
+      const tUint kk = _perm[k];
+      for(tUint p = Ap[kk]; p < Ap[kk+1]; ++p) {
+        for(int i = _iperm[Ai[p]]; i < (int)k && flag[i] != (int)k; i = _parent[i]) {
+          if(_parent[i] == none)
+            _parent[i] = k;
+          ++lnz[i];
+          flag[i] = k;
+        }
+      }
+    }
+    _Lp.assign(n + 1, 0);
+    for(tUint k = 0; k < n; ++k)
+      _Lp[k+1] = _Lp[k] + lnz[k];
+    _Li.resize(_Lp[n]);
+    _Lx.resize(_Lp[n]);
+    _D.resize(n);
+  }
+
+  // Numeric factorization; false if the matrix is not positive definite
+  bool factor(const std::vector<tUint> &Ap, const std::vector<tUint> &Ai, const std::vector<double> &Ax)
+  {
+    const tUint n = _n;
+    std::vector<double> y(n, 0.0);
+    std::vector<tUint> pattern(n), lnz(n, 0);
+    std::vector<int> flag(n);
+    _factored = false;
+
+    for(tUint k = 0; k < n; ++k) {
+      // nonzero pattern of row k of L, in topological order
+      tUint top = n;
+      flag[k] = k;
+      const tUint kk = _perm[k];
+      for(tUint p = Ap[kk]; p < Ap[kk+1]; ++p) {
+        int i = _iperm[Ai[p]];
+        if(i > (int)k)
+          continue;
+        y[i] += Ax[p];
+        tUint len = 0;
+        for(; flag[i] != (int)k; i = _parent[i]) {
+          pattern[len++] = i;
+          flag[i] = k;
+        }
+        while(len > 0)
+          pattern[--top] = pattern[--len];
+      }
+
+      // sparse triangular solve for row k
+      _D[k] = y[k];
+      y[k] = 0.0;
+      for(; top < n; ++top) {
+        const tUint i = pattern[top];
+        const double yi = y[i];
+        y[i] = 0.0;
+        const tUint p2 = _Lp[i] + lnz[i];
+        for(tUint p = _Lp[i]; p < p2; ++p)
+          y[_Li[p]] -= _Lx[p]*yi;
+        const double l_ki = yi / _D[i];
+        _D[k] -= l_ki*yi;
+        _Li[p2] = k;
+        _Lx[p2] = l_ki;
+        ++lnz[i];
+      }
+      if(_D[k] <= 0.0)
+        return false;
+    }
+    _factored = true;
+    return true;
+  }
+
+  // Solves A x = b for three right-hand sides at once, in place
+  void solve(std::vector<glm::dvec3> &b)
+  {
+    const tUint n = _n;
+    _x.resize(n);
+    for(tUint k = 0; k < n; ++k)
+      _x[k] = b[_perm[k]];
+    for(tUint j = 0; j < n; ++j)
+      for(tUint p = _Lp[j]; p < _Lp[j+1]; ++p)
+        _x[_Li[p]] -= _Lx[p]*_x[j];
+    for(tUint j = 0; j < n; ++j)
+      _x[j] /= _D[j];
+    for(int j = n - 1; j >= 0; --j)
+      for(tUint p = _Lp[j]; p < _Lp[j+1]; ++p)
+        _x[j] -= _Lx[p]*_x[_Li[p]];
+    for(tUint k = 0; k < n; ++k)
+      b[_perm[k]] = _x[k];
+  }
+
+private:
+  // Reverse Cuthill-McKee: breadth-first from a low-degree vertex of every
+  // component, neighbours by increasing degree, keeps the profile of L narrow
+  void orderRCM(const std::vector<tUint> &Ap, const std::vector<tUint> &Ai)
+  {
+    const tUint n = _n;
+    std::vector<tUint> order(n), deg(n), nbrs;
+    for(tUint i = 0; i < n; ++i) {
+      order[i] = i;
+      deg[i] = Ap[i+1] - Ap[i];
+    }
+    std::stable_sort(order.begin(), order.end(), [&](tUint a, tUint b) { return deg[a] < deg[b]; });
+
+    std::vector<bool> visited(n, false);
+    _perm.clear();
+    for(tUint s : order) {
+      if(visited[s])
+        continue;
+      visited[s] = true;
+      tUint head = _perm.size();
+      _perm.push_back(s);
+      for(; head < _perm.size(); ++head) {
+        const tUint v = _perm[head];
+        nbrs.clear();
+        for(tUint p = Ap[v]; p < Ap[v+1]; ++p)
+          if(!visited[Ai[p]]) {
+            visited[Ai[p]] = true;
+            nbrs.push_back(Ai[p]);
+          }
+        std::sort(nbrs.begin(), nbrs.end(), [&](tUint a, tUint b) { return deg[a] < deg[b]; });
+        _perm.insert(_perm.end(), nbrs.begin(), nbrs.end());
+      }
+    }
+    std::reverse(_perm.begin(), _perm.end());
+    _iperm.resize(n);
+    for(tUint k = 0; k < n; ++k)
+      _iperm[_perm[k]] = k;
+  }
+
+  tUint _n = 0;
+  bool _factored = false;
+  std::vector<tUint> _perm, _iperm; // row k of the factor is row _perm[k] of A
+  std::vector<int> _parent;         // elimination tree, -1 at the roots
+  std::vector<tUint> _Lp, _Li;      // strictly lower L, column-wise
+  std::vector<double> _Lx, _D;
+  std::vector<glm::dvec3> _x;       // workspace of the solves
+};
+
+#endif  /* _SPARSECHOLESKY_HPP_ */
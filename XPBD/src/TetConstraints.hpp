@@ -0,0 +1,194 @@
+// ----------------------------------------------------------------------------
+// TetConstraints.hpp
+//
+// Description: XPBD volume and Neo-Hookean constraints on tetrahedra, stored
+//              as coloured SoA batches
+// ----------------------------------------------------------------------------
+
+#ifndef _TETCONSTRAINTS_HPP_
+#define _TETCONSTRAINTS_HPP_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "Coloring.hpp"
+
+// Material of a tetrahedral body
+struct TetMaterial {
+  enum Model {
+    kVolume,                    // volume preservation only, no shear resistance
+    kNeoHookean,                // compressible Neo-Hookean
+  };
+
+  Model model = kNeoHookean;
+  tReal youngs = 2e5f;          // Young's modulus [Pa]
+  tReal poisson = 0.4f;         // Poisson ratio
+  tReal volume_compliance = 0.f; // compliance of the plain volume constraint
+  tReal density = 100.f;        // [kg/m^3], sets the vertex masses
+};
+
+// One batch of tets sharing a material. Tets are sorted by colour so that the
+// range of a colour can be projected in parallel, and every per-tet quantity
+// is its own array so that the loops stream through memory.
+struct TetConstraintBatch {
+  void build(const std::vector<glm::vec3> &x, const std::vector<glm::uvec4> &tets, const TetMaterial &mat)
+  {
+    _model = mat.model;
+    _mu = mat.youngs / (2.f*(1.f + mat.poisson));
+    _la = mat.youngs*mat.poisson / ((1.f + mat.poisson)*(1.f - 2.f*mat.poisson));
+    _alpha_vol = mat.volume_compliance;
+
+    std::vector<tUint> flat(4*tets.size()), color, perm;
+    for(tUint t = 0; t < tets.size(); ++t)
+      for(int k = 0; k < 4; ++k)
+        flat[4*t + k] = tets[t][k];
+    const tUint num_colors = colorElements(flat, 4, x.size(), color);
+    sortByColor(color, num_colors, perm, _color_offsets);
+
+    const tUint n = tets.size();
+    for(int k = 0; k < 4; ++k) _i[k].resize(n);
+    for(int k = 0; k < 9; ++k) _Dm_inv[k].resize(n);
+    _V0.resize(n);
+    _lambda_D.assign(n, 0.f);
+    _lambda_H.assign(n, 0.f);
+
+    for(tUint s = 0; s < n; ++s) {
+      const glm::uvec4 &t = tets[perm[s]];
+      for(int k = 0; k < 4; ++k) _i[k][s] = t[k];
+      const glm::mat3 Dm(x[t[1]] - x[t[0]], x[t[2]] - x[t[0]], x[t[3]] - x[t[0]]);
+      const glm::mat3 Dm_inv = glm::inverse(Dm);
+      for(int k = 0; k < 9; ++k) _Dm_inv[k][s] = Dm_inv[k/3][k%3];
+      _V0[s] = glm::determinant(Dm) / 6.f;
+    }
+  }
+
+  tUint size() const { return _V0.size(); }
+  tUint numColors() const { return _color_offsets.empty() ? 0 : _color_offsets.size() - 1; }
+
+  void reset()
+  {
+    std::fill(_lambda_D.begin(), _lambda_D.end(), 0.f);
+    std::fill(_lambda_H.begin(), _lambda_H.end(), 0.f);
+  }
+
+  // Lumped vertex masses: every tet gives a quarter of its mass to its vertices
+  void accumulateMass(std::vector<tReal> &m, const tReal density) const
+  {
+    for(tUint s = 0; s < size(); ++s)
+      for(int k = 0; k < 4; ++k)
+        m[_i[k][s]] += 0.25f*density*_V0[s];
+  }
+
+  void project(std::vector<glm::vec3> &x, const std::vector<tReal> &w, const tReal dt)
+  {
+    const tReal inv_dt2 = 1.f / (dt*dt);
+    for(tUint c = 0; c < numColors(); ++c) {
+      const int begin = _color_offsets[c], end = _color_offsets[c+1];
+      // no two tets of a colour share a vertex
+#pragma omp parallel for
+      for(int s = begin; s < end; ++s) {
+        if(_model == TetMaterial::kNeoHookean) {
+          solveNeoHookean(s, x, w, inv_dt2/(_mu*_V0[s]), inv_dt2/(_la*_V0[s]));
+        } else {
+          solveVolume(s, x, w, _alpha_vol*inv_dt2);
+        }
+      }
+    }
+  }
+
+private:
+  glm::mat3 invRest(const int s) const
+  {
+    return glm::mat3(
+      _Dm_inv[0][s], _Dm_inv[1][s], _Dm_inv[2][s],
+      _Dm_inv[3][s], _Dm_inv[4][s], _Dm_inv[5][s],
+      _Dm_inv[6][s], _Dm_inv[7][s], _Dm_inv[8][s]);
+  }
+
+  glm::mat3 deformationGradient(const int s, const std::vector<glm::vec3> &x) const
+  {
+    const glm::vec3 &x0 = x[_i[0][s]];
+    const glm::mat3 Ds(x[_i[1][s]] - x0, x[_i[2][s]] - x0, x[_i[3][s]] - x0);
+    return Ds*invRest(s);
+  }
+
+  // One XPBD update from the gradients wrt x1..x3; the one of x0 follows from
+  // translation invariance
+  void applyGradients(
+    const int s, std::vector<glm::vec3> &x, const std::vector<tReal> &w,
+    const glm::vec3 g[3], const tReal C, const tReal alpha_tilda, tReal &lambda)
+  {
+    const glm::vec3 g0 = -(g[0] + g[1] + g[2]);
+    const tReal w0 = w[_i[0][s]], w1 = w[_i[1][s]], w2 = w[_i[2][s]], w3 = w[_i[3][s]];
+    const tReal denom = w0*glm::dot(g0, g0) + w1*glm::dot(g[0], g[0]) +
+                        w2*glm::dot(g[1], g[1]) + w3*glm::dot(g[2], g[2]) + alpha_tilda;
+    if(denom < 1e-12f)
+      return;
+
+    const tReal dlambda = (-C - alpha_tilda*lambda) / denom;
+    x[_i[0][s]] += w0*dlambda*g0;
+    x[_i[1][s]] += w1*dlambda*g[0];
+    x[_i[2][s]] += w2*dlambda*g[1];
+    x[_i[3][s]] += w3*dlambda*g[2];
+    lambda += dlambda;
+  }
+
+  // Compressible Neo-Hookean energy mu/2 (I_C - 3 - 2 log J) + lambda/2 (J - 1)^2
+  // split into two constraints. Both vanish at rest: the rest-stressed pair of
+  // [Macklin and Muller 2021] is only stable in Gauss-Seidel sweeps when the
+  // time step is small, which the frame-sized steps of this solver are not.
+  void solveNeoHookean(
+    const int s, std::vector<glm::vec3> &x, const std::vector<tReal> &w,
+    const tReal alpha_D, const tReal alpha_H)
+  {
+    const glm::mat3 Dm_inv_T = glm::transpose(invRest(s));
+
+    // deviatoric: C_D = sqrt(I_C - 3 - 2 log J), dC/dF = (F - F^-T) / C_D
+    {
+      const glm::mat3 F = deformationGradient(s, x);
+      const glm::mat3 cof(glm::cross(F[1], F[2]), glm::cross(F[2], F[0]), glm::cross(F[0], F[1]));
+      const tReal J = std::max(glm::dot(F[0], cof[0]), 1e-3f);
+      const tReal I_C = glm::dot(F[0], F[0]) + glm::dot(F[1], F[1]) + glm::dot(F[2], F[2]);
+      const tReal C = std::sqrt(std::max(I_C - 3.f - 2.f*std::log(J), 0.f));
+      if(C > 1e-6f) {
+        const glm::mat3 G = ((F - cof/J) / C)*Dm_inv_T;
+        const glm::vec3 g[3] = {G[0], G[1], G[2]};
+        applyGradients(s, x, w, g, C, alpha_D, _lambda_D[s]);
+      }
+    }
+
+    // hydrostatic: C_H = J - 1, dC/dF = cofactor matrix of F
+    {
+      const glm::mat3 F = deformationGradient(s, x);
+      const glm::mat3 cof(glm::cross(F[1], F[2]), glm::cross(F[2], F[0]), glm::cross(F[0], F[1]));
+      const glm::mat3 G = cof*Dm_inv_T;
+      const glm::vec3 g[3] = {G[0], G[1], G[2]};
+      applyGradients(s, x, w, g, glm::dot(F[0], cof[0]) - 1.f, alpha_H, _lambda_H[s]);
+    }
+  }
+
+  // C_V = V - V0
+  void solveVolume(const int s, std::vector<glm::vec3> &x, const std::vector<tReal> &w, const tReal alpha_tilda)
+  {
+    const glm::vec3 &x0 = x[_i[0][s]];
+    const glm::vec3 e1 = x[_i[1][s]] - x0, e2 = x[_i[2][s]] - x0, e3 = x[_i[3][s]] - x0;
+    const glm::vec3 g[3] = {glm::cross(e2, e3)/6.f, glm::cross(e3, e1)/6.f, glm::cross(e1, e2)/6.f};
+    const tReal C = glm::dot(e1, g[0]) - _V0[s];
+    applyGradients(s, x, w, g, C, alpha_tilda, _lambda_H[s]);
+  }
+
+  TetMaterial::Model _model;
+  tReal _mu, _la;               // Lame parameters
+  tReal _alpha_vol;             // volume compliance
+
+  std::vector<tUint> _i[4];     // vertex ids
+  std::vector<tReal> _Dm_inv[9]; // inverse rest matrix, column-major
+  std::vector<tReal> _V0;       // rest volume
+  std::vector<tReal> _lambda_D, _lambda_H; // Lagrange multipliers
+  std::vector<tUint> _color_offsets; // tets of colour c: [_color_offsets[c], _color_offsets[c+1])
+};
+
+#endif  /* _TETCONSTRAINTS_HPP_ */
@@ -0,0 +1,194 @@
+#include "TetMesh.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <ios>
+#include <string>
+
+namespace {
+
+// Face k of a positively oriented tet, wound so that its normal points outward
+const unsigned int kTetFaces[4][3] = {{1, 2, 3}, {0, 3, 2}, {0, 1, 3}, {0, 2, 1}};
+
+struct TetFace {
+  glm::uvec3 key;               // sorted vertex ids
+  glm::uvec3 tri;               // outward winding
+  bool operator<(const TetFace &o) const
+  {
+    if(key[0] != o.key[0]) return key[0] < o.key[0];
+    if(key[1] != o.key[1]) return key[1] < o.key[1];
+    return key[2] < o.key[2];
+  }
+};
+
+// Reads the next line that is neither empty nor a '#' comment
+bool nextRecord(std::ifstream &in, std::istringstream &line)
+{
+  std::string s;
+  while(std::getline(in, s)) {
+    const size_t p = s.find_first_not_of(" \t\r");
+    if(p == std::string::npos || s[p] == '#')
+      continue;
+    line.clear();
+    line.str(s);
+    return true;
+  }
+  return false;
+}
+
+}
+
+void TetMesh::orientTets()
+{
+  for(auto &t : _tetIndices) {
+    const glm::vec3 &x0 = _vertexPositions[t[0]];
+    const float vol = glm::dot(
+      _vertexPositions[t[1]] - x0,
+      glm::cross(_vertexPositions[t[2]] - x0, _vertexPositions[t[3]] - x0));
+    if(vol < 0.f)
+      std::swap(t[2], t[3]);
+  }
+}
+
+void TetMesh::extractSurface(MeshData &mesh)
+{
+  std::vector<TetFace> faces;
+  faces.reserve(4*_tetIndices.size());
+  for(const auto &t : _tetIndices) {
+    for(int f = 0; f < 4; ++f) {
+      TetFace face;
+      face.tri = glm::uvec3(t[kTetFaces[f][0]], t[kTetFaces[f][1]], t[kTetFaces[f][2]]);
+      unsigned int k[3] = {face.tri[0], face.tri[1], face.tri[2]};
+      std::sort(k, k + 3);
+      face.key = glm::uvec3(k[0], k[1], k[2]);
+      faces.push_back(face);
+    }
+  }
+  std::sort(faces.begin(), faces.end());
+
+  // interior faces are shared by two tets; the boundary ones appear once
+  const unsigned int unset = static_cast<unsigned int>(-1);
+  std::vector<unsigned int> tetToSurface(_vertexPositions.size(), unset);
+  _surfaceVertices.clear();
+  mesh.clear();
+  auto &P = mesh.vertexPositions();
+  auto &T = mesh.triangleIndices();
+  for(size_t i = 0; i < faces.size(); ) {
+    size_t j = i + 1;
+    while(j < faces.size() && !(faces[i] < faces[j]))
+      ++j;
+    if(j - i == 1) {
+      glm::uvec3 tri;
+      for(int c = 0; c < 3; ++c) {
+        const unsigned int v = faces[i].tri[c];
+        if(tetToSurface[v] == unset) {
+          tetToSurface[v] = _surfaceVertices.size();
+          _surfaceVertices.push_back(v);
+          P.push_back(_vertexPositions[v]);
+        }
+        tri[c] = tetToSurface[v];
+      }
+      T.push_back(tri);
+    }
+    i = j;
+  }
+
+  mesh.vertexNormals().resize(P.size(), glm::vec3(0.f, 0.f, 1.f));
+  mesh.recomputePerVertexNormals();
+  mesh.recomputePerVertexTextureCoordinates();
+}
+
+void TetMesh::clear()
+{
+  _vertexPositions.clear();
+  _tetIndices.clear();
+  _surfaceVertices.clear();
+}
+
+void TetMesh::addBox(
+  const float w, const float h, const float d,
+  const unsigned int nx, const unsigned int ny, const unsigned int nz)
+{
+  const unsigned int i_cur = _vertexPositions.size();
+  const glm::vec3 start(-0.5f*w, -0.5f*h, -0.5f*d);
+  const glm::vec3 cell(w/nx, h/ny, d/nz);
+
+  for(unsigned int i = 0; i <= nx; ++i)
+    for(unsigned int j = 0; j <= ny; ++j)
+      for(unsigned int k = 0; k <= nz; ++k)
+        _vertexPositions.push_back(start + cell*glm::vec3(i, j, k));
+
+  auto id = [&](unsigned int i, unsigned int j, unsigned int k) {
+    return i_cur + (i*(ny + 1) + j)*(nz + 1) + k;
+  };
+
+  // Kuhn subdivision: the 6 tets of a cell share its main diagonal and follow
+  // the paths 000 -> 111 along the axes, which keeps neighbouring cells conforming
+  const unsigned int paths[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+  for(unsigned int i = 0; i < nx; ++i) {
+    for(unsigned int j = 0; j < ny; ++j) {
+      for(unsigned int k = 0; k < nz; ++k) {
+        for(const auto &p : paths) {
+          glm::uvec3 c(i, j, k);
+          glm::uvec4 t;
+          t[0] = id(c[0], c[1], c[2]);
+          for(int s = 0; s < 3; ++s) {
+            ++c[p[s]];
+            t[s + 1] = id(c[0], c[1], c[2]);
+          }
+          _tetIndices.push_back(t);
+        }
+      }
+    }
+  }
+  orientTets();
+}
+
+// Loads a TetGen mesh. See https://wias-berlin.de/software/tetgen/fformats.html
+void loadTetGen(const std::string &basename, std::shared_ptr<TetMesh> tetPtr)
+{
+  std::cout << " > Start loading tet mesh <" << basename << ">" << std::endl;
+  tetPtr->clear();
+  std::istringstream line;
+
+  std::ifstream node((basename + ".node").c_str());
+  if(!node || !nextRecord(node, line))
+    throw std::ios_base::failure("[TetMesh Loader][loadTetGen] Cannot open " + basename + ".node");
+  unsigned int sizeV, dim;
+  line >> sizeV >> dim;
+  if(dim != 3)
+    throw std::ios_base::failure("[TetMesh Loader][loadTetGen] Not a 3D node file: " + basename);
+  auto &P = tetPtr->vertexPositions();
+  P.resize(sizeV);
+  unsigned int firstId = 0;
+  for(unsigned int i = 0; i < sizeV; ++i) {
+    unsigned int id;
+    if(!nextRecord(node, line))
+      throw std::ios_base::failure("[TetMesh Loader][loadTetGen] Truncated node file: " + basename);
+    line >> id;
+    if(i == 0) firstId = id;     // TetGen indices start at 0 or 1
+    line >> P[i][0] >> P[i][1] >> P[i][2];
+  }
+
+  std::ifstream ele((basename + ".ele").c_str());
+  if(!ele || !nextRecord(ele, line))
+    throw std::ios_base::failure("[TetMesh Loader][loadTetGen] Cannot open " + basename + ".ele");
+  unsigned int sizeT, nodesPerTet;
+  line >> sizeT >> nodesPerTet;
+  if(nodesPerTet < 4)
+    throw std::ios_base::failure("[TetMesh Loader][loadTetGen] Not a tet file: " + basename);
+  auto &T = tetPtr->tetIndices();
+  T.resize(sizeT);
+  for(unsigned int i = 0; i < sizeT; ++i) {
+    unsigned int id;
+    if(!nextRecord(ele, line))
+      throw std::ios_base::failure("[TetMesh Loader][loadTetGen] Truncated ele file: " + basename);
+    line >> id >> T[i][0] >> T[i][1] >> T[i][2] >> T[i][3];
+    T[i] -= glm::uvec4(firstId);
+  }
+  tetPtr->orientTets();
+  std::cout << " > Tet mesh <" << basename << "> loaded: " << sizeV << " vertices, " << sizeT << " tets" << std::endl;
+}
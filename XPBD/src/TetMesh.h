@@ -0,0 +1,49 @@
+#ifndef TET_MESH_H
+#define TET_MESH_H
+
+#include <vector>
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+class MeshData;
+
+// Tetrahedral volume mesh. The solver simulates every vertex, but only the
+// boundary is extracted to a mesh for rendering.
+class TetMesh {
+public:
+  const std::vector<glm::vec3> &vertexPositions() const { return _vertexPositions; }
+  std::vector<glm::vec3> &vertexPositions() { return _vertexPositions; }
+
+  // Positively oriented tetrahedra: (x1-x0).((x2-x0)x(x3-x0)) > 0
+  const std::vector<glm::uvec4> &tetIndices() const { return _tetIndices; }
+  std::vector<glm::uvec4> &tetIndices() { return _tetIndices; }
+
+  // Tet vertex id of every surface vertex, filled by extractSurface()
+  const std::vector<unsigned int> &surfaceVertices() const { return _surfaceVertices; }
+
+  // Flip the tets with a negative volume so that all of them are positively oriented
+  void orientTets();
+
+  // Fill mesh with the boundary triangles only, on a compact vertex set
+  void extractSurface(MeshData &mesh);
+
+  void clear();
+
+  // Built-in tetrahedralizer for boxes: w x h x d box centered at the origin,
+  // split into nx x ny x nz cells of 6 tets each
+  void addBox(
+    const float w, const float h, const float d,
+    const unsigned int nx, const unsigned int ny, const unsigned int nz);
+
+private:
+  std::vector<glm::vec3> _vertexPositions;
+  std::vector<glm::uvec4> _tetIndices;
+  std::vector<unsigned int> _surfaceVertices;
+};
+
+// utility: loader for TetGen <basename>.node / <basename>.ele pairs
+void loadTetGen(const std::string &basename, std::shared_ptr<TetMesh> tetPtr);
+
+#endif  // TET_MESH_H
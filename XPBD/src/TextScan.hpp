@@ -0,0 +1,129 @@
+// ----------------------------------------------------------------------------
+// TextScan.hpp
+//
+// Description: Number parsing over a character range that is not null
+//              terminated, as a memory-mapped file, for the mesh loaders
+// ----------------------------------------------------------------------------
+
+#ifndef _TEXTSCAN_HPP_
+#define _TEXTSCAN_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Every function advances p and never reads at or past end.
+
+inline bool isBlank(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Skips blanks within the line
+inline void skipBlanks(const char *&p, const char *end)
+{
+  while(p < end && isBlank(*p)) ++p;
+}
+
+// Moves past the next '\n'
+inline void skipLine(const char *&p, const char *end)
+{
+  const void *nl = std::memchr(p, '\n', end - p);
+  p = nl ? static_cast<const char *>(nl) + 1 : end;
+}
+
+// True at the end of a line or of a '#' comment
+inline bool atLineEnd(const char *p, const char *end)
+{
+  return p == end || *p == '\n' || *p == '#';
+}
+
+// Skips the lines that are empty or '#' comments
+inline void skipEmptyLines(const char *&p, const char *end)
+{
+  for(;;) {
+    skipBlanks(p, end);
+    if(p == end || !atLineEnd(p, end))
+      return;
+    skipLine(p, end);
+  }
+}
+
+inline bool parseUint(const char *&p, const char *end, unsigned int &v)
+{
+  skipBlanks(p, end);
+  const char *start = p;
+  std::uint64_t x = 0;
+  while(p < end && unsigned(*p - '0') < 10u && x <= 0xffffffffu)
+    x = 10*x + (*p++ - '0');
+  v = static_cast<unsigned int>(x);
+  return p != start && x <= 0xffffffffu;
+}
+
+// Decimal or scientific notation. Mantissas below 2^53 with exponents in
+// [-22, 22], which covers what mesh exporters write, take one rounded double
+// operation, within the last bit of strtof; anything else goes through strtof
+inline bool parseFloat(const char *&p, const char *end, float &v)
+{
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  skipBlanks(p, end);
+  const char *start = p;
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  std::uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any = false;
+  for(; p < end && unsigned(*p - '0') < 10u; ++p, any = true) {
+    if(digits < 19) {
+      mantissa = 10*mantissa + (*p - '0');
+      if(mantissa) ++digits;
+    } else {
+      ++exponent;
+    }
+  }
+  if(p < end && *p == '.') {
+    for(++p; p < end && unsigned(*p - '0') < 10u; ++p, any = true) {
+      if(digits < 19) {
+        mantissa = 10*mantissa + (*p - '0');
+        if(mantissa) ++digits;
+        --exponent;
+      }
+    }
+  }
+  if(any && p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool negative_exp = false;
+    if(q < end && (*q == '-' || *q == '+'))
+      negative_exp = *q++ == '-';
+    int e = 0;
+    bool any_exp = false;
+    for(; q < end && unsigned(*q - '0') < 10u; ++q, any_exp = true)
+      if(e < 100000) e = 10*e + (*q - '0');
+    if(any_exp) {
+      exponent += negative_exp ? -e : e;
+      p = q;
+    }
+  }
+
+  if(any && mantissa < (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+    const double m = double(mantissa);
+    const double x = exponent < 0 ? m / kPow10[-exponent] : m * kPow10[exponent];
+    v = float(negative ? -x : x);
+    return true;
+  }
+
+  // long mantissas, large exponents, inf and nan
+  char buf[64];
+  const char *token_end = start;
+  while(token_end < end && token_end - start < 63 && !isBlank(*token_end) && *token_end != '\n')
+    ++token_end;
+  std::memcpy(buf, start, token_end - start);
+  buf[token_end - start] = '\0';
+  char *parsed;
+  v = std::strtof(buf, &parsed);
+  p = start + (parsed - buf);
+  return parsed != buf;
+}
+
+#endif  /* _TEXTSCAN_HPP_ */
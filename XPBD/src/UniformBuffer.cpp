@@ -0,0 +1,27 @@
+#include "UniformBuffer.h"
+
+#include <cstddef>
+
+UniformBuffer::UniformBuffer(GLuint binding, GLsizeiptr size) : _binding(binding), _size(size)
+{
+  glGenBuffers(1, &_ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+  glBufferData(GL_UNIFORM_BUFFER, _size, NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, _binding, _ubo);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+  glDeleteBuffers(1, &_ubo);
+}
+
+void UniformBuffer::update(const void *data, GLsizeiptr size, GLintptr offset)
+{
+  glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+  if(offset == 0 && size == _size)
+    glBufferData(GL_UNIFORM_BUFFER, _size, data, GL_DYNAMIC_DRAW); // whole block: orphan the previous one
+  else
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,31 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+// Buffer of a std140 uniform block, bound once to its binding point, where
+// every program reading the block finds it (ShaderProgram::bindUniformBlock).
+// The C++ structs written to it mirror the std140 layout of their block: vec3
+// members are followed by a scalar or padded to 16 bytes.
+class UniformBuffer {
+public:
+  UniformBuffer(GLuint binding, GLsizeiptr size);
+  UniformBuffer(const UniformBuffer &) = delete;
+  UniformBuffer &operator=(const UniformBuffer &) = delete;
+  virtual ~UniformBuffer();
+
+  GLuint binding() const { return _binding; }
+
+  // Once per frame, before the draws reading the block
+  void update(const void *data, GLsizeiptr size, GLintptr offset=0);
+
+  template<typename T>
+  void update(const T &block) { update(&block, sizeof(T)); }
+
+private:
+  GLuint _ubo = 0;
+  GLuint _binding;
+  GLsizeiptr _size;
+};
+
+#endif  // UNIFORM_BUFFER_H
@@ -0,0 +1,174 @@
+// ----------------------------------------------------------------------------
+// VertexCache.hpp
+//
+// Description: Orders of the triangles and vertices of a mesh for the
+//              post-transform vertex cache and the vertex fetch of the GPU
+// ----------------------------------------------------------------------------
+
+#ifndef _VERTEXCACHE_HPP_
+#define _VERTEXCACHE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "NeighborGrid.hpp"
+
+const int kVertexCacheSize = 32; // LRU cache modelled by optimizeVertexCache()
+
+// Average cache miss ratio: vertices transformed per triangle, drawn in order
+// through a FIFO cache of cache_size vertices; 0.5 at best on large meshes, 3
+// at worst
+inline float vertexCacheMissRatio(
+  const std::vector<glm::uvec3> &triangles, const tUint num_vertices, const int cache_size=16)
+{
+  if(triangles.empty())
+    return 0.f;
+  std::vector<tUint> loaded(num_vertices, 0); // miss count when it entered the cache, plus one
+  tUint misses = 0;
+  for(const auto &t : triangles) {
+    for(int a = 0; a < 3; ++a) {
+      if(loaded[t[a]] == 0 || misses - loaded[t[a]] >= tUint(cache_size))
+        loaded[t[a]] = ++misses;
+    }
+  }
+  return float(misses) / triangles.size();
+}
+
+// Score of a vertex by its place in the cache and its triangles left to draw,
+// tabulated for the places in the cache and the usual valences
+inline float vertexCacheScore(const int position, const tUint live)
+{
+  struct Table {
+    float position[kVertexCacheSize + 1], valence[32];
+    Table()
+    {
+      position[0] = 0.f;          // out of the cache
+      for(int k = 0; k < kVertexCacheSize; ++k)   // the last triangle's vertices are kept as good as each other
+        position[k + 1] = k < 3 ? 0.75f : std::pow(1.f - float(k - 3) / (kVertexCacheSize - 3), 1.5f);
+      for(int l = 1; l < 32; ++l)
+        valence[l] = 2.f / std::sqrt(float(l));
+    }
+  };
+  static const Table table;
+
+  if(live == 0)
+    return -1.f;
+  return table.position[position + 1] + (live < 32 ? table.valence[live] : 2.f / std::sqrt(float(live)));
+}
+
+// Greedy triangle order of [Forsyth 2006]: the next triangle is the best
+// scored among those of the vertices in a modelled LRU cache, scores being
+// updated for the cache only, so that the cost is linear in the triangles.
+inline void optimizeVertexCache(std::vector<glm::uvec3> &triangles, const tUint num_vertices)
+{
+  const tUint nt = triangles.size();
+  if(nt == 0)
+    return;
+
+  // triangles of every vertex, the first live[v] of them still to draw
+  std::vector<tUint> start(num_vertices + 1, 0);
+  for(const auto &t : triangles)
+    for(int a = 0; a < 3; ++a)
+      ++start[t[a]];
+  exclusiveScan(start);
+  std::vector<tUint> adjacent(start[num_vertices]), live(num_vertices, 0);
+  for(tUint t = 0; t < nt; ++t)
+    for(int a = 0; a < 3; ++a) {
+      const tUint v = triangles[t][a];
+      adjacent[start[v] + live[v]++] = t;
+    }
+
+  std::vector<int> position(num_vertices, -1);
+  std::vector<float> vertex_score(num_vertices), triangle_score(nt, 0.f);
+  for(tUint v = 0; v < num_vertices; ++v)
+    vertex_score[v] = vertexCacheScore(-1, live[v]);
+  for(tUint t = 0; t < nt; ++t)
+    for(int a = 0; a < 3; ++a)
+      triangle_score[t] += vertex_score[triangles[t][a]];
+
+  std::vector<bool> drawn(nt, false);
+  std::vector<glm::uvec3> order;
+  order.reserve(nt);
+  std::vector<tUint> cache, next_cache;
+  cache.reserve(kVertexCacheSize + 3);
+  next_cache.reserve(kVertexCacheSize + 3);
+  tUint best = 0, cursor = 0;
+  for(tUint t = 1; t < nt; ++t)
+    if(triangle_score[t] > triangle_score[best]) best = t;
+
+  while(order.size() < nt) {
+    if(best == nt) {            // nothing left around the cache: next one in input order
+      while(drawn[cursor]) ++cursor;
+      best = cursor;
+    }
+    const glm::uvec3 tri = triangles[best];
+    drawn[best] = true;
+    order.push_back(tri);
+
+    // the triangle leaves the live triangles of its vertices, which go to
+    // the front of the cache
+    next_cache.clear();
+    for(int a = 0; a < 3; ++a) {
+      const tUint v = tri[a];
+      tUint *first = &adjacent[start[v]], *last = first + live[v] - 1;
+      for(tUint *p = first; p <= last; ++p)
+        if(*p == best) {
+          std::swap(*p, *last);
+          break;
+        }
+      --live[v];
+      next_cache.push_back(v);
+    }
+    for(tUint v : cache)
+      if(v != tri[0] && v != tri[1] && v != tri[2])
+        next_cache.push_back(v);
+    cache.swap(next_cache);
+
+    // scores of the vertices in or out of the cache, then of their triangles
+    for(tUint k = 0; k < cache.size(); ++k) {
+      const tUint v = cache[k];
+      position[v] = k < tUint(kVertexCacheSize) ? int(k) : -1;
+      const float score = vertexCacheScore(position[v], live[v]);
+      const float delta = score - vertex_score[v];
+      vertex_score[v] = score;
+      for(tUint j = start[v]; j < start[v] + live[v]; ++j)
+        triangle_score[adjacent[j]] += delta;
+    }
+    if(cache.size() > tUint(kVertexCacheSize))
+      cache.resize(kVertexCacheSize);
+
+    best = nt;
+    float best_score = -1.f;
+    for(tUint v : cache)
+      for(tUint j = start[v]; j < start[v] + live[v]; ++j)
+        if(triangle_score[adjacent[j]] > best_score) {
+          best_score = triangle_score[adjacent[j]];
+          best = adjacent[j];
+        }
+  }
+  triangles.swap(order);
+}
+
+// Renumbers the vertices in the order the triangles first use them, the
+// unused ones last; new_index[old vertex] is the new index.
+inline void optimizeVertexFetch(
+  std::vector<glm::uvec3> &triangles, const tUint num_vertices, std::vector<tUint> &new_index)
+{
+  const tUint kUnset = ~0u;
+  new_index.assign(num_vertices, kUnset);
+  tUint next = 0;
+  for(auto &t : triangles)
+    for(int a = 0; a < 3; ++a) {
+      if(new_index[t[a]] == kUnset)
+        new_index[t[a]] = next++;
+      t[a] = new_index[t[a]];
+    }
+  for(tUint v = 0; v < num_vertices; ++v)
+    if(new_index[v] == kUnset)
+      new_index[v] = next++;
+}
+
+#endif  /* _VERTEXCACHE_HPP_ */
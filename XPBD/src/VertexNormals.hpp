@@ -0,0 +1,119 @@
+// ----------------------------------------------------------------------------
+// VertexNormals.hpp
+//
+// Description: Per-vertex normals of a triangle mesh of fixed topology, as a
+//              parallel gather over the triangles incident to each vertex
+// ----------------------------------------------------------------------------
+
+#ifndef _VERTEXNORMALS_HPP_
+#define _VERTEXNORMALS_HPP_
+
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "typedefs.hpp"
+#include "NeighborGrid.hpp"
+
+// build() stores the corners incident to each vertex, in CSR form. compute()
+// is then a parallel pass over the triangles writing the weighted normal of
+// every corner, and a parallel gather of the corners of every vertex: each
+// cross product is done once, nothing is scattered and nothing allocated once
+// the buffers have their size. PbdSolver splits the two passes to fuse the
+// gather with its last loop over the vertices.
+class VertexNormals {
+public:
+  explicit VertexNormals(const bool angle_weighted=false) : _angle_weighted(angle_weighted) {}
+
+  void setAngleWeighted(const bool angle_weighted) { _angle_weighted = angle_weighted; }
+
+  void build(const tUint num_vertices, const std::vector<glm::uvec3> &triangles)
+  {
+    _triangles = triangles;
+    _start.assign(num_vertices + 1, 0);
+    for(const auto &t : triangles)
+      for(int a = 0; a < 3; ++a)
+        ++_start[t[a]];
+    exclusiveScan(_start);
+    _corners.resize(_start[num_vertices]);
+    _fill.assign(_start.begin(), _start.end() - 1);
+    for(tUint t = 0; t < triangles.size(); ++t)
+      for(int a = 0; a < 3; ++a)
+        _corners[_fill[triangles[t][a]]++] = 3*t + a;
+    _corner_n.resize(3*triangles.size());
+  }
+
+  void clear()
+  {
+    _triangles.clear();
+    _start.clear();
+    _corners.clear();
+  }
+
+  // True if built for a mesh of these sizes
+  bool builtFor(const tUint num_vertices, const tUint num_triangles) const
+  {
+    return !_start.empty() && _start.size() == num_vertices + 1 && _triangles.size() == num_triangles;
+  }
+
+  // First pass: the normals of the corners, weighted by the area of their
+  // triangle or by their angle
+  void computeCorners(const std::vector<glm::vec3> &x)
+  {
+    const int nt = _triangles.size();
+    if(_angle_weighted) {
+#pragma omp parallel for
+      for(int t = 0; t < nt; ++t) {
+        const glm::uvec3 &tri = _triangles[t];
+        const glm::vec3 e[3] = {x[tri[1]] - x[tri[0]], x[tri[2]] - x[tri[1]], x[tri[0]] - x[tri[2]]};
+        const glm::vec3 c = glm::cross(e[0], -e[2]);
+        const tReal s = glm::length(c);
+        const glm::vec3 u = s > 0.f ? c/s : glm::vec3(0.f);
+        for(int a = 0; a < 3; ++a) // interior angle between the edges leaving the corner
+          _corner_n[3*t + a] = std::atan2(s, -glm::dot(e[a], e[(a + 2) % 3]))*u;
+      }
+    } else {
+#pragma omp parallel for
+      for(int t = 0; t < nt; ++t) {
+        const glm::uvec3 &tri = _triangles[t];
+        const glm::vec3 c = glm::cross(x[tri[1]] - x[tri[0]], x[tri[2]] - x[tri[0]]);
+        _corner_n[t] = c;       // shared by the three corners
+      }
+    }
+  }
+
+  // Second pass for one vertex: unit normal, zero without area around it
+  glm::vec3 gather(const tUint i) const
+  {
+    glm::vec3 n(0.f);
+    if(_angle_weighted) {
+      for(tUint k = _start[i]; k < _start[i+1]; ++k)
+        n += _corner_n[_corners[k]];
+    } else {
+      for(tUint k = _start[i]; k < _start[i+1]; ++k)
+        n += _corner_n[_corners[k]/3];
+    }
+    const tReal len = glm::length(n);
+    return len > 0.f ? n/len : n;
+  }
+
+  void compute(const std::vector<glm::vec3> &x, std::vector<glm::vec3> &n)
+  {
+    const int nv = _start.size() - 1;
+    computeCorners(x);
+    n.resize(nv);
+#pragma omp parallel for
+    for(int i = 0; i < nv; ++i)
+      n[i] = gather(i);
+  }
+
+private:
+  bool _angle_weighted;
+  std::vector<glm::uvec3> _triangles;
+  std::vector<tUint> _start;       // corners of vertex i: _corners[_start[i] .. _start[i+1]]
+  std::vector<tUint> _corners;     // corner a of triangle t is 3*t + a
+  std::vector<glm::vec3> _corner_n;
+  std::vector<tUint> _fill;        // scratch of build()
+};
+
+#endif  /* _VERTEXNORMALS_HPP_ */
@@ -0,0 +1,82 @@
+// ----------------------------------------------------------------------------
+// VertexPacking.hpp
+//
+// Description: Compact vertex format for streaming: positions quantized to 16
+//              bits in their bounding box and normals in 2_10_10_10
+// ----------------------------------------------------------------------------
+
+#ifndef _VERTEXPACKING_HPP_
+#define _VERTEXPACKING_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "typedefs.hpp"
+
+// 12 bytes instead of 24: position as normalized GL_UNSIGNED_SHORT x 3, and
+// normal as normalized GL_INT_2_10_10_10_REV, interleaved
+struct PackedVertex {
+  std::uint16_t position[4];    // the 4th is padding
+  std::uint32_t normal;
+};
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex is read with a stride of 12 bytes");
+
+inline void boundingBox(const glm::vec3 *x, const int n, glm::vec3 &lo, glm::vec3 &hi)
+{
+  lo = hi = n > 0 ? x[0] : glm::vec3(0.f);
+#pragma omp parallel
+  {
+    glm::vec3 l = lo, h = hi;
+#pragma omp for nowait
+    for(int i = 0; i < n; ++i) {
+      l = glm::min(l, x[i]);
+      h = glm::max(h, x[i]);
+    }
+#pragma omp critical
+    {
+      lo = glm::min(lo, l);
+      hi = glm::max(hi, h);
+    }
+  }
+}
+
+// Positions x = lo + q*extent/65535 with the 16-bit q, to within 1/131070 of
+// the box, and normals to within 1/1022 a component. The loop is branch-free
+// so that the arithmetic of a vertex is vectorized.
+inline void packVertices(
+  const glm::vec3 *x, const glm::vec3 *n, const int count, const glm::vec3 &lo, const glm::vec3 &extent,
+  PackedVertex *out)
+{
+  const glm::vec3 scale(
+    extent[0] > 0.f ? 65535.f/extent[0] : 0.f,
+    extent[1] > 0.f ? 65535.f/extent[1] : 0.f,
+    extent[2] > 0.f ? 65535.f/extent[2] : 0.f);
+#pragma omp parallel for
+  for(int i = 0; i < count; ++i) {
+    const glm::vec3 q = glm::clamp((x[i] - lo)*scale + 0.5f, glm::vec3(0.f), glm::vec3(65535.f));
+    // 511 n rounded, shifted to be positive so that truncation rounds, as
+    // two's complement 10-bit fields
+    const glm::vec3 m = glm::clamp(n[i], glm::vec3(-1.f), glm::vec3(1.f))*511.f + 512.5f;
+    const glm::ivec3 s = (glm::ivec3(m) - 512) & 0x3ff;
+    PackedVertex v;
+    v.position[0] = std::uint16_t(q[0]);
+    v.position[1] = std::uint16_t(q[1]);
+    v.position[2] = std::uint16_t(q[2]);
+    v.position[3] = 0;
+    v.normal = std::uint32_t(s[0]) | std::uint32_t(s[1]) << 10 | std::uint32_t(s[2]) << 20;
+    out[i] = v;
+  }
+}
+
+// Texture coordinates as two half floats, for a static buffer
+inline void packHalfTexCoords(const std::vector<glm::vec2> &uv, std::vector<std::uint32_t> &out)
+{
+  out.resize(uv.size());
+  for(tUint i = 0; i < uv.size(); ++i)
+    out[i] = glm::packHalf2x16(uv[i]);
+}
+
+#endif  /* _VERTEXPACKING_HPP_ */
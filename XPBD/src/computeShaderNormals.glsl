@@ -0,0 +1,31 @@
+#version 430 core            // with SUPPORT_OPENGL_45
+
+// Normal of every vertex from the streamed positions
+
+layout(local_size_x = 64) in;
+
+// float arrays: a vec3 array would have a stride of 16 bytes in std430
+layout(std430, binding = 0) readonly buffer Positions { float positions[]; };
+layout(std430, binding = 1) readonly buffer Adjacency { uint adjacency[]; }; // as in vertexShaderNormals.glsl
+layout(std430, binding = 2) writeonly buffer Normals { float normals[]; };
+
+uniform uint count;
+
+vec3 position(uint i) {
+  return vec3(positions[3u*i], positions[3u*i + 1u], positions[3u*i + 2u]);
+}
+
+void main() {
+  uint i = gl_GlobalInvocationID.x;
+  if(i >= count)
+    return;
+  vec3 x = position(i);
+  vec3 n = vec3(0.0);
+  for(uint k = adjacency[i]; k < adjacency[i + 1u]; k += 2u)
+    n += cross(position(adjacency[k]) - x, position(adjacency[k + 1u]) - x);
+  float len = length(n);
+  n = len > 0.0 ? n/len : n;
+  normals[3u*i] = n.x;
+  normals[3u*i + 1u] = n.y;
+  normals[3u*i + 2u] = n.z;
+}
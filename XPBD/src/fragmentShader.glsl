@@ -1,27 +1,27 @@
 #version 330 core            // minimal GL version support expected from the GPU
 
-struct LightSource {
+// uniform blocks, updated once per frame; their std140 layout is mirrored in main.cpp
+layout(std140) uniform Light {
   vec3 position;
-  vec3 color;
   float intensity;
-};
-
-uniform LightSource lightSrc;
+  vec3 color;
+  mat4 shadowMapMVP;
+} lightSrc;
 uniform sampler2D shadowMapTex;
-uniform mat4 shadowMapMVP;
 
 struct Material {
   vec3 albedo;
-  sampler2D albedoTex;
   int albedoTexLoaded;
-
-  sampler2D normalTex;
   int normalTexLoaded;
 };
 
-uniform Material material;
-
-uniform vec3 camPos;
+const int kMaxMaterials = 8;
+layout(std140) uniform Materials {
+  Material materials[kMaxMaterials];
+};
+uniform int materialId;         // material of the object drawn
+uniform sampler2D albedoTex;    // samplers cannot be in a block
+uniform sampler2D normalTex;
 
 in vec3 fPositionModel;
 in vec3 fPosition;
@@ -37,14 +37,15 @@ float pi = 3.1415927;
 float shadowOffset = 0.001;
 
 void main() {
+  Material material = materials[materialId];
   vec3 n = (material.normalTexLoaded == 1) ?
-    normalize(normMat*((texture(material.normalTex, fTexCoord).rgb - 0.5)*2.0)) : // colors are in [0,1]^3, and normals are in [-1,1]^3
+    normalize(normMat*((texture(normalTex, fTexCoord).rgb - 0.5)*2.0)) : // colors are in [0,1]^3, and normals are in [-1,1]^3
     normalize(fNormal);
 
   // linear barycentric interpolation does not preserve unit vectors
   // vec3 wo = normalize(camPos - fPosition); // unit vector pointing to the camera
 
-  vec4 ShadowCoord = shadowMapMVP*modelMat*vec4(fPositionModel, 1);
+  vec4 ShadowCoord = lightSrc.shadowMapMVP*modelMat*vec4(fPositionModel, 1);
   ShadowCoord /= ShadowCoord.w;
 
   // so far, ShadowCoord is in [-1,1]^3, put it in [0,1]^3:
@@ -57,7 +58,7 @@ void main() {
   } else {
     vec3 wi = normalize(lightSrc.position - fPosition); // unit vector pointing to the light source
     vec3 Li = lightSrc.color*lightSrc.intensity;
-    vec3 albedo = material.albedoTexLoaded==1 ? texture(material.albedoTex, fTexCoord).rgb : material.albedo;
+    vec3 albedo = material.albedoTexLoaded==1 ? texture(albedoTex, fTexCoord).rgb : material.albedo;
     //vec3 albedo = material.albedo;
 
     radiance += Li*albedo*max(dot(n, wi), 0);
@@ -67,8 +68,8 @@ void main() {
   {
     // !!!!!! DEBUG YOUR TEXTURES !!!!!! :
     //   radiance = vec3(1) * max(dot(n,wo),0.0);
-    //   radiance = 0.001*radiance + 0.999*((texture(material.normalTex, fTexCoord).rgb));
-    //   radiance = 0.001*radiance + 0.999*((texture(material.albedoTex, fTexCoord).rgb));
+    //   radiance = 0.001*radiance + 0.999*((texture(normalTex, fTexCoord).rgb));
+    //   radiance = 0.001*radiance + 0.999*((texture(albedoTex, fTexCoord).rgb));
   }
 
   colorOut = vec4(radiance, 1.0); // build an RGBA value from an RGB one
@@ -39,22 +39,41 @@
 #include <memory>
 #include <algorithm>
 #include <exception>
+#include <limits>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 // #include "Error.h" // OpenGL 4.3 or later
 #include "ShaderProgram.h"
+#include "UniformBuffer.h"
+#include "FrameCapture.h"
+#ifdef SUPPORT_HEADLESS
+#include "Headless.h"
+#endif
 #include "Camera.h"
 #include "Mesh.h"
+#include "GpuNormals.h"
+#include "TetMesh.h"
 
 #include "PbdSolver.hpp"
+#include "Scenes.hpp"
+#include "MeshEmbedding.hpp"
+#include "LoopSubdivision.hpp"
 
 // window parameters
 GLFWwindow *g_window = nullptr;
 int g_windowWidth = 1024;
 int g_windowHeight = 768;
 GLint g_polygonMode = GL_FILL;
+GLuint g_framebuffer = 0;       // the window's, or the offscreen one when headless
+
+// headless mode: no window, g_headlessFrames frames rendered offscreen and
+// written to disk
+int g_headlessFrames = 0;
+#ifdef SUPPORT_HEADLESS
+HeadlessContext g_headless;
+#endif
 
 // pointer to the current camera model
 std::shared_ptr<Camera> g_cam;
@@ -68,6 +87,13 @@ double g_baseX = 0.0, g_baseY = 0.0;
 glm::vec3 g_baseTrans(0.0);
 glm::vec3 g_baseRot(0.0);
 
+// recording: frames piped to this command, or else written as c00000.tga, ...
+std::string g_recordCommand;
+
+// program binaries and rest states of the cloth kept between launches; "":
+// nothing cached
+std::string g_cacheDirectory = "cache";
+
 // timer
 float g_appTimer = 0.0;
 float g_appTimerLastClockTime;
@@ -126,24 +152,80 @@ class FboShadowMap {
 public:
   GLuint getTextureId() const { return _depthMapTexture; }
 
+  unsigned int width() const { return _depthMapTextureWidth; }
+
+  // The shadow map, and a cache of the same size for the depth of the static
+  // shadow casters
   bool allocate(unsigned int width=1024, unsigned int height=768)
   {
-    glGenFramebuffers(1, &_depthMapFbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, _depthMapFbo);
-
     _depthMapTextureWidth = width;
     _depthMapTextureHeight = height;
+    return allocateDepth(_staticDepthFbo, _staticDepthTexture) && allocateDepth(_depthMapFbo, _depthMapTexture);
+  }
+
+  void bindFbo()
+  {
+    glViewport(0, 0, _depthMapTextureWidth, _depthMapTextureHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, _depthMapFbo);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // you can now render the geometry, assuming you have set the view matrix
+    // according to the light viewpoint
+  }
+
+  // To render the static shadow casters, once for as long as they and the
+  // light stay where they are
+  void bindStaticFbo()
+  {
+    glViewport(0, 0, _depthMapTextureWidth, _depthMapTextureHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, _staticDepthFbo);
+    glClear(GL_DEPTH_BUFFER_BIT);
+  }
+
+  // As bindFbo(), but the shadow map starts as the depth of the static
+  // shadow casters instead of cleared, and only the moving ones are rendered
+  void bindFboFromStatic()
+  {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _staticDepthFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _depthMapFbo);
+    glBlitFramebuffer(
+      0, 0, _depthMapTextureWidth, _depthMapTextureHeight, 0, 0, _depthMapTextureWidth, _depthMapTextureHeight,
+      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _depthMapFbo);
+    glViewport(0, 0, _depthMapTextureWidth, _depthMapTextureHeight);
+  }
+
+  void free()
+  {
+    glDeleteFramebuffers(1, &_depthMapFbo);
+    glDeleteFramebuffers(1, &_staticDepthFbo);
+    glDeleteTextures(1, &_depthMapTexture);
+    glDeleteTextures(1, &_staticDepthTexture);
+    _depthMapFbo = _staticDepthFbo = _depthMapTexture = _staticDepthTexture = 0;
+  }
+
+  // Depth as a binary .pgm or .pfm, read back and written in the background
+  void dump(FrameCapture &capture, const std::string &filename) const
+  {
+    capture.dumpAttachment(filename, _depthMapFbo, GL_DEPTH_ATTACHMENT, _depthMapTextureWidth, _depthMapTextureHeight);
+  }
+
+private:
+  bool allocateDepth(GLuint &fbo, GLuint &texture)
+  {
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
     // Depth texture. Slower than a depth buffer, but you can sample it later in your shader
-    glGenTextures(1, &_depthMapTexture);
-    glBindTexture(GL_TEXTURE_2D, _depthMapTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, _depthMapTextureWidth, _depthMapTextureHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _depthMapTexture, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
 
     glDrawBuffer(GL_NONE);      // No color buffers are written.
 
@@ -157,54 +239,12 @@ public:
     }
   }
 
-  void bindFbo()
-  {
-    glViewport(0, 0, _depthMapTextureWidth, _depthMapTextureHeight);
-    glBindFramebuffer(GL_FRAMEBUFFER, _depthMapFbo);
-    glClear(GL_DEPTH_BUFFER_BIT);
-
-    // you can now render the geometry, assuming you have set the view matrix
-    // according to the light viewpoint
-  }
-
-  void free() { glDeleteFramebuffers(1, &_depthMapFbo); }
-
-  void savePpmFile(std::string const &filename)
-  {
-    std::ofstream output_image(filename.c_str());
-
-    // READ THE PIXELS VALUES from FBO AND SAVE TO A .PPM FILE
-    int i, j, k;
-    float *pixels = new float[_depthMapTextureWidth*_depthMapTextureHeight];
-
-    // READ THE CONTENT FROM THE FBO
-    glReadBuffer(GL_COLOR_ATTACHMENT0);
-    glReadPixels(0, 0, _depthMapTextureWidth, _depthMapTextureHeight, GL_DEPTH_COMPONENT , GL_FLOAT, pixels);
-
-    output_image << "P3" << std::endl;
-    output_image << _depthMapTextureWidth << " " << _depthMapTextureHeight << std::endl;
-    output_image << "255" << std::endl;
-
-    k = 0;
-    for(i=0; i<_depthMapTextureWidth; ++i) {
-      for(j=0; j<_depthMapTextureHeight; ++j) {
-        output_image <<
-          static_cast<unsigned int>(255*pixels[k]) << " " <<
-          static_cast<unsigned int>(255*pixels[k]) << " " <<
-          static_cast<unsigned int>(255*pixels[k]) << " ";
-        k = k+1;
-      }
-      output_image << std::endl;
-    }
-    delete [] pixels;
-    output_image.close();
-  }
-
-private:
-  GLuint _depthMapFbo;
-  GLuint _depthMapTexture;
-  unsigned int _depthMapTextureWidth;
-  unsigned int _depthMapTextureHeight;
+  GLuint _depthMapFbo = 0;
+  GLuint _depthMapTexture = 0;
+  GLuint _staticDepthFbo = 0;   // depth of the static shadow casters alone
+  GLuint _staticDepthTexture = 0;
+  unsigned int _depthMapTextureWidth = 0;
+  unsigned int _depthMapTextureHeight = 0;
 };
 
 struct Light {
@@ -230,16 +270,52 @@ struct Light {
     depthMVP = proj_mat * view_mat * model_mat;
   }
 
+  // Also on resizing: the shadow map texture is bound again to its unit
   void allocateShadowMapFbo(unsigned int w=800, unsigned int h=600)
   {
+    shadowMap.free();
     shadowMap.allocate(w, h);
+    glActiveTexture(GL_TEXTURE0 + shadowMapTexOnGPU);
+    glBindTexture(GL_TEXTURE_2D, shadowMap.getTextureId());
+    glActiveTexture(GL_TEXTURE0);
   }
-  void bindShadowMap()
-  {
-    shadowMap.bindFbo();
-  }
 };
 
+// range of the side of the shadow map, fit to the view of the cloth
+const unsigned int kMinShadowMapSize = 512;
+const unsigned int kMaxShadowMapSize = 4096;
+
+// std140 uniform blocks of the main shader, updated once per frame
+enum UniformBlockBinding { kCameraBlock = 0, kLightBlock, kMaterialBlock };
+
+struct CameraBlock {
+  glm::mat4 viewMat;
+  glm::mat4 projMat;
+  glm::vec4 camPos;             // xyz
+};
+
+struct LightBlock {
+  glm::vec3 position;
+  float intensity;
+  glm::vec3 color;
+  float pad;
+  glm::mat4 shadowMapMVP;
+};
+
+struct MaterialBlock {
+  glm::vec3 albedo;
+  GLint albedoTexLoaded;
+  GLint normalTexLoaded;
+  GLint pad[3];                 // an array of structs has a stride of 16 bytes
+};
+
+// materialId of the objects drawn, kMaxMaterials in fragmentShader.glsl
+enum SceneMaterial { kFloorMaterial = 0, kClothMaterial, kFluidMaterial, kPropMaterial, kNumMaterials };
+const int kMaxMaterials = 8;
+
+static_assert(sizeof(CameraBlock) == 144 && sizeof(LightBlock) == 96 && sizeof(MaterialBlock) == 32,
+  "uniform blocks must follow the std140 layout");
+
 struct Scene {
   Light light;
 
@@ -247,7 +323,20 @@ struct Scene {
 
   // meshes
   std::shared_ptr<Mesh> cloth = nullptr;
+  std::shared_ptr<Mesh> clothRender = nullptr; // finer mesh following the cloth, drawn instead of it
+  bool subdivideClothP = true;  // clothRender is the cloth subdivided, or a finer grid embedded on it
+  VertexStream clothStream = VertexStream::kPositionsOnly; // how clothRender goes to the GPU, kCompact if too large for GpuNormals
+  GpuNormals clothNormals;      // normals of clothRender without streamed ones
+  LoopSubdivision clothSubdivision;
+  MeshEmbedding clothEmbedding;
   std::shared_ptr<Mesh> plane = nullptr;
+  std::shared_ptr<TetMesh> body = nullptr; // volume of the soft body, its surface goes to cloth
+  bool softBodyP = false;
+  bool stiffPatchP = false;     // shape matching on the hanging end of the cloth
+  std::shared_ptr<PbfFluid> fluid = nullptr;
+  std::shared_ptr<Mesh> fluidPoints = nullptr; // rendered as points
+  std::shared_ptr<RigidBodies> props = nullptr;
+  std::shared_ptr<Mesh> propCube = nullptr; // [-1, 1]^3, scaled onto every body
 
   // transformation matrices
   glm::mat4 clothMat = glm::mat4(1.0);
@@ -260,128 +349,363 @@ struct Scene {
   // shaders to render the meshes and shadow maps
   std::shared_ptr<ShaderProgram> mainShader, shadomMapShader;
 
+  // uniform blocks of mainShader, and locations of the uniforms set per object
+  std::shared_ptr<UniformBuffer> cameraUbo, lightUbo, materialUbo;
+  GLint modelMatLoc = -1, normMatLoc = -1, materialIdLoc = -1, depthMVPLoc = -1;
+
+  // the shadow map is rendered again only when something moved, and its
+  // static part only when the light or the size of the map changed
+  bool shadowDirtyP = true;
+  bool staticShadowP = false;
+
   // useful for debug
-  bool saveShadowMapsPpm = false;
+  bool saveShadowMap = false;
   bool saveScreenShot = false;
   int savedCnt = 0;
+  std::shared_ptr<FrameCapture> capture; // screenshots and recordings
+
 
   void resetSim()
   {
+    shadowDirtyP = true;
+    fluid.reset();
+    fluidPoints.reset();
+    props.reset();
+    clothRender.reset();
     cloth = std::make_shared<Mesh>();
-    cloth->addCloth(15, 30, 0.6f, 1.2f);
-    // cloth->addCloth(30, 15, 1.2f, 0.6f);
-    // cloth->addCube(0.5f);
+    if(softBodyP) {
+      body = std::make_shared<TetMesh>();
+      addSceneSoftBody(*body);
+      body->extractSurface(*cloth);
+      cloth->init();
+      cloth->enableStreaming();
+
+      solver.initSim(*body);
+      return;
+    }
+
+    addSceneCloth(*cloth);
     cloth->init();
 
-    solver.initSim(*cloth);
+    solver.initSim(*cloth, std::vector<tUint>(), sceneClothPins());
+    resetRenderCloth();
+
+    if(stiffPatchP)
+      solver.addShapeMatching(sceneStiffPatch(cloth->vertexPositions()));
   }
 
-  void render()
+  // Pour a block of liquid over the current scene
+  void addFluid()
   {
-    //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-    // first, render the shadow map(s)
+    shadowDirtyP = true;
+    fluid = makeSceneFluid();
+    solver.attachFluid(fluid);
+
+    fluidPoints = std::make_shared<Mesh>();
+    fluidPoints->vertexPositions() = fluid->positions();
+    fluidPoints->vertexNormals().resize(fluid->size(), glm::vec3(0.f, 1.f, 0.f));
+    fluidPoints->vertexTexCoords().resize(fluid->size(), glm::vec2(0.f));
+    fluidPoints->init();
+  }
+
+  // A hinged chain holding the free corner of the cloth, and a box dropped on
+  // the table
+  void addProps()
+  {
+    shadowDirtyP = true;
+    if(softBodyP)
+      return;
+    props = makeSceneProps();
+    solver.attachRigidBodies(props);
+
+    if(!propCube) {
+      propCube = std::make_shared<Mesh>();
+      propCube->addBox(2.f, 2.f, 2.f);
+      propCube->init();
+    }
+  }
+
+  // Drawn at four times the resolution of the cloth at rest
+  void resetRenderCloth()
+  {
+    clothRender = std::make_shared<Mesh>();
+    if(subdivideClothP) {
+      clothSubdivision.build(cloth->vertexPositions().size(), cloth->triangleIndices(), 2);
+      clothSubdivision.refine(cloth->vertexPositions(), clothRender->vertexPositions(), clothRender->vertexNormals());
+      clothRender->vertexTexCoords().resize(clothSubdivision.size());
+      clothSubdivision.apply(cloth->vertexTexCoords(), clothRender->vertexTexCoords().data());
+      clothRender->triangleIndices() = clothSubdivision.triangles();
+    } else {
+      clothRender->addCloth(57, 117, 0.6f, 1.2f);
+      clothEmbedding.build(
+        cloth->vertexPositions(), cloth->vertexNormals(), cloth->triangleIndices(), clothRender->vertexPositions());
+    }
+    if(clothStream == VertexStream::kPositionsOnly && !GpuNormals::fits(*clothRender)) {
+      std::cerr << "[Scene][resetRenderCloth] Too many vertices for the normals on the GPU: computed on the CPU, "
+                << "streamed compact" << std::endl;
+      clothStream = VertexStream::kCompact;
+    }
+    clothRender->init();
+    clothRender->enableStreaming(clothStream);
+    if(clothStream == VertexStream::kPositionsOnly) {
+      clothNormals.build(*clothRender);
+      clothNormals.compute(*clothRender);
+    }
+  }
+
+  // After a step: the simulated surface, and the mesh drawn for it streamed
+  // to the GPU once for the shadow and the main passes. The embedding writes
+  // straight to the mapped buffer, and so does the subdivision when the GPU
+  // computes the normals; otherwise it reads its positions back for them,
+  // which mapped memory is too slow for.
+  void updateMeshes()
+  {
+    shadowDirtyP = true;
+    if(fluid) {
+      fluidPoints->vertexPositions() = fluid->positions();
+      fluidPoints->bufferData(true, false);
+    }
+    solver.updateMesh(*cloth);
+    if(!clothRender) {
+      cloth->streamData();
+      return;
+    }
+    const bool gpuNormals = clothStream == VertexStream::kPositionsOnly;
+    if(subdivideClothP && !gpuNormals) {
+      clothSubdivision.refine(cloth->vertexPositions(), clothRender->vertexPositions(), clothRender->vertexNormals());
+      clothRender->streamData();
+    } else {
+      glm::vec3 *positions, *normals;
+      clothRender->beginStreaming(positions, normals);
+      if(subdivideClothP)
+        clothSubdivision.apply(cloth->vertexPositions(), positions);
+      else
+        clothEmbedding.apply(cloth->vertexPositions(), cloth->vertexNormals(), positions, normals);
+      clothRender->endStreaming();
+    }
+    if(gpuNormals)
+      clothNormals.compute(*clothRender);
+  }
+
+  // Once the shaders are linked
+  void initUniforms()
+  {
+    cameraUbo = std::make_shared<UniformBuffer>(kCameraBlock, sizeof(CameraBlock));
+    lightUbo = std::make_shared<UniformBuffer>(kLightBlock, sizeof(LightBlock));
+    materialUbo = std::make_shared<UniformBuffer>(kMaterialBlock, kMaxMaterials*sizeof(MaterialBlock));
+    mainShader->bindUniformBlock("Camera", kCameraBlock);
+    mainShader->bindUniformBlock("Light", kLightBlock);
+    mainShader->bindUniformBlock("Materials", kMaterialBlock);
+
+    modelMatLoc = mainShader->getLocation("modelMat");
+    normMatLoc = mainShader->getLocation("normMat");
+    materialIdLoc = mainShader->getLocation("materialId");
+    depthMVPLoc = shadomMapShader->getLocation("depthMVP");
+  }
+
+  void updateUniforms()
+  {
+    CameraBlock camera;
+    camera.viewMat = g_cam->computeViewMatrix();
+    camera.projMat = g_cam->computeProjectionMatrix();
+    camera.camPos = glm::vec4(g_cam->getPosition(), 1.f);
+    cameraUbo->update(camera);
+
+    LightBlock lightBlock;
+    lightBlock.position = light.position;
+    lightBlock.intensity = light.intensity;
+    lightBlock.color = light.color;
+    lightBlock.shadowMapMVP = light.depthMVP;
+    lightUbo->update(lightBlock);
+
+    MaterialBlock materials[kMaxMaterials] = {};
+    materials[kFloorMaterial].albedo = glm::vec3(0.8, 0.8, 0.9);
+    materials[kClothMaterial].albedo = glm::vec3(1, 0.71, 0.29);
+    materials[kClothMaterial].albedoTexLoaded = 1;
+    materials[kFluidMaterial].albedo = glm::vec3(0.2, 0.4, 0.9);
+    materials[kPropMaterial].albedo = glm::vec3(0.5, 0.5, 0.55);
+    materialUbo->update(materials);
+  }
+
+  // Side of the shadow map for about one texel per pixel around the cloth:
+  // the map spans 2*extent and the screen 2*d*tan(fov/2) at the distance d
+  // of the cloth. Powers of two, shrunk only well below half the size.
+  unsigned int shadowMapSize() const
+  {
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for(const glm::vec3 &x : cloth->vertexPositions()) {
+      lo = glm::min(lo, x);
+      hi = glm::max(hi, x);
+    }
+    const glm::vec3 center = glm::vec3(clothMat*glm::vec4(0.5f*(lo + hi), 1.f));
+    const float radius = 0.5f*glm::length(hi - lo);
+    const float d = std::max(glm::length(g_cam->getPosition() - center) - radius, g_cam->getNear());
+    const float extent = scene_radius*1.5f;
+    const float wanted = extent*g_windowHeight / (d*std::tan(glm::radians(0.5f*g_cam->getFov())));
+
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    const unsigned int current = light.shadowMap.width();
+    unsigned int size = kMinShadowMapSize;
+    while(size < wanted && size < kMaxShadowMapSize && size < (unsigned int)maxSize/2)
+      size *= 2;
+    return (size < current && wanted > 0.4f*current) ? current : size;
+  }
+
+  // Skipped while nothing moves, e.g. while the simulation is paused
+  void renderShadowMap(Mesh &clothSurface)
+  {
+    const unsigned int size = shadowMapSize();
+    if(size != light.shadowMap.width()) {
+      light.allocateShadowMapFbo(size, size);
+      staticShadowP = false;
+    }
+    const glm::mat4 depthMVP = light.depthMVP;
+    light.setupCameraForShadowMapping(shadomMapShader, scene_center, scene_radius*1.5f);
+    if(depthMVP != light.depthMVP)
+      staticShadowP = false;
+    if(staticShadowP && !shadowDirtyP && !saveShadowMap)
+      return;
+
     glEnable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
     shadomMapShader->use();
-    light.setupCameraForShadowMapping(shadomMapShader, scene_center, scene_radius*1.5f);
-    light.bindShadowMap();
 
-    // render the objects in the scene
-    // shadomMapShader->set("depthMVP", light.depthMVP*planeMat);
-    // plane->render();
+    // static objects, once into the cache
+    if(!staticShadowP) {
+      light.shadowMap.bindStaticFbo();
+      // shadomMapShader->set(depthMVPLoc, light.depthMVP*planeMat);
+      // plane->render();
 
-    shadomMapShader->set("depthMVP", light.depthMVP*floorMat);
-    plane->render();
+      shadomMapShader->set(depthMVPLoc, light.depthMVP*floorMat);
+      plane->render();
+      staticShadowP = true;
+    }
 
+    // moving objects, over a copy of the cache
+    light.shadowMap.bindFboFromStatic();
     glDisable(GL_CULL_FACE);
-    shadomMapShader->set("depthMVP", light.depthMVP*clothMat);
-    cloth->bufferData(true, true);
-    cloth->render();
+    shadomMapShader->set(depthMVPLoc, light.depthMVP*clothMat*clothSurface.positionDecodeMatrix());
+    clothSurface.render();
 
-    if(saveShadowMapsPpm) {
-      light.shadowMap.savePpmFile(std::string("shadom_map.ppm"));
+    if(fluid) {
+      shadomMapShader->set(depthMVPLoc, light.depthMVP);
+      fluidPoints->renderPoints();
+    }
+
+    if(props) {
+      for(tUint b = 0; b < props->size(); ++b) {
+        shadomMapShader->set(depthMVPLoc, light.depthMVP*props->modelMatrix(b));
+        propCube->render();
+      }
+    }
+
+    if(saveShadowMap) {
+      light.shadowMap.dump(*capture, "shadow_map.pgm"); // to look at
+      light.shadowMap.dump(*capture, "shadow_map.pfm"); // exact depth
     }
     shadomMapShader->stop();
-    saveShadowMapsPpm = false;
+    saveShadowMap = false;
+    shadowDirtyP = false;
+  }
+
+  void render()
+  {
+    Mesh &clothSurface = clothRender ? *clothRender : *cloth;
+
+    //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+    // first, render the shadow map(s)
+    renderShadowMap(clothSurface);
     //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
     //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
     // second, render the screen
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer);
     glViewport(0, 0, g_windowWidth, g_windowHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear the color and z buffers.
 
     glDisable(GL_CULL_FACE);    // or
     //glCullFace(GL_BACK);
 
+    updateUniforms();
     mainShader->use();
-
-    // camera
-    mainShader->set("camPos", g_cam->getPosition());
-    mainShader->set("viewMat", g_cam->computeViewMatrix());
-    mainShader->set("projMat", g_cam->computeProjectionMatrix());
-
-    // light
-    mainShader->set(std::string("lightSrc.position"), light.position);
-    mainShader->set(std::string("lightSrc.color"), light.color);
-    mainShader->set(std::string("lightSrc.intensity"), light.intensity);
-    mainShader->set(std::string("shadowMapTex"), (int)light.shadowMapTexOnGPU);
-    mainShader->set(std::string("shadowMapMVP"), light.depthMVP);
+    mainShader->set("shadowMapTex", (int)light.shadowMapTexOnGPU);
+    mainShader->set("albedoTex", (int)g_albedoTexOnGPU);
 
     // back-wall
-    // mainShader->set("material.albedo", glm::vec3(0.29, 0.51, 0.82)); // default value if the texture was not loaded
-    // mainShader->set("material.albedoTexLoaded", 0);
-    // mainShader->set("material.normalTex", (int)g_normalTexOnGPU);
-    // mainShader->set("material.normalTexLoaded", 1);
-    // mainShader->set("modelMat", planeMat);
-    // mainShader->set("normMat", glm::mat3(glm::inverseTranspose(planeMat)));
+    // mainShader->set("normalTex", (int)g_normalTexOnGPU);
+    // mainShader->set(materialIdLoc, ...); // a material with normalTexLoaded = 1
+    // mainShader->set(modelMatLoc, planeMat);
+    // mainShader->set(normMatLoc, glm::mat3(glm::inverseTranspose(planeMat)));
     // plane->render();
 
     // floor
-    mainShader->set("material.albedo", glm::vec3(0.8, 0.8, 0.9));
-    mainShader->set("material.albedoTexLoaded", 0);
-    mainShader->set("material.normalTexLoaded", 0);
-    mainShader->set("modelMat", floorMat);
-    mainShader->set("normMat", glm::mat3(glm::inverseTranspose(floorMat)));
+    mainShader->set(materialIdLoc, (int)kFloorMaterial);
+    mainShader->set(modelMatLoc, floorMat);
+    mainShader->set(normMatLoc, glm::mat3(glm::inverseTranspose(floorMat)));
     plane->render();
 
     // cloth
-    mainShader->set("material.albedo", glm::vec3(1, 0.71, 0.29));
-    mainShader->set("material.albedoTex", (int)g_albedoTexOnGPU);
-    mainShader->set("material.albedoTexLoaded", 1);
-    mainShader->set("material.normalTexLoaded", 0);
-    mainShader->set("modelMat", clothMat);
-    mainShader->set("normMat", glm::mat3(glm::inverseTranspose(clothMat)));
-    cloth->bufferData(true, true);
-    cloth->render();
+    mainShader->set(materialIdLoc, (int)kClothMaterial);
+    mainShader->set(modelMatLoc, clothMat*clothSurface.positionDecodeMatrix());
+    mainShader->set(normMatLoc, glm::mat3(glm::inverseTranspose(clothMat)));
+    clothSurface.render();
+
+    // fluid
+    if(fluid) {
+      mainShader->set(materialIdLoc, (int)kFluidMaterial);
+      mainShader->set(modelMatLoc, glm::mat4(1.0));
+      mainShader->set(normMatLoc, glm::mat3(1.0));
+      glPointSize(4.f);
+      fluidPoints->renderPoints();
+    }
+
+    // rigid props
+    if(props) {
+      mainShader->set(materialIdLoc, (int)kPropMaterial);
+      for(tUint b = 0; b < props->size(); ++b) {
+        const glm::mat4 propMat = props->modelMatrix(b);
+        mainShader->set(modelMatLoc, propMat);
+        mainShader->set(normMatLoc, glm::mat3(glm::inverseTranspose(propMat)));
+        propCube->render();
+      }
+    }
 
     mainShader->stop();
     //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
+    // readbacks through pixel buffers, written by the capture threads
     if(saveScreenShot) {
       std::stringstream fpath;
       fpath << "s" << std::setw(4) << std::setfill('0') << savedCnt++ << ".tga";
-
-      std::cout << "Saving file " << fpath.str() << " ... " << std::flush;
-      const short int w = g_windowWidth;
-      const short int h = g_windowHeight;
-      std::vector<int> buf(w*h*3, 0);
-      glReadPixels(0, 0, w, h, GL_BGR, GL_UNSIGNED_BYTE, &(buf[0]));
-
-      FILE *out = fopen(fpath.str().c_str(), "wb");
-      short TGAhead[] = {0, 2, 0, 0, 0, 0, w, h, 24};
-      fwrite(&TGAhead, sizeof(TGAhead), 1, out);
-      fwrite(&(buf[0]), 3*w*h, 1, out);
-      fclose(out);
+      std::cout << "Saving file " << fpath.str() << std::endl;
+      capture->captureOnce(fpath.str(), g_windowWidth, g_windowHeight);
       saveScreenShot = false;
-
-      std::cout << "Done" << std::endl;
     }
+    capture->update(g_windowWidth, g_windowHeight);
   }
 };
 
 Scene g_scene;
 
+// Names of the streams of the render cloth, for --cloth-stream and the V key
+const char *streamName(const VertexStream stream)
+{
+  return stream == VertexStream::kPositionsOnly ? "gpu-normals" :
+    stream == VertexStream::kCompact ? "compact" : "float";
+}
+
+bool streamFromName(const std::string &name, VertexStream &stream)
+{
+  for(const VertexStream s : {VertexStream::kPositionsOnly, VertexStream::kCompact, VertexStream::kFloat}) {
+    if(name == streamName(s)) {
+      stream = s;
+      return true;
+    }
+  }
+  return false;
+}
+
 void printHelp()
 {
   std::cout <<
@@ -394,7 +718,15 @@ void printHelp()
     "    * H: print this help" << std::endl <<
     "    * P: toggle simulation" << std::endl <<
     "    * R: reset simulation" << std::endl <<
+    "    * B: switch between the cloth and the soft-body box" << std::endl <<
+    "    * F: pour liquid over the scene" << std::endl <<
+    "    * J: hang the cloth corner from a hinged chain and drop a box" << std::endl <<
+    "    * T: toggle the stiff patch on the hanging end of the cloth" << std::endl <<
+    "    * L: switch the rendered cloth between subdivided and embedded" << std::endl <<
+    "    * V: stream the rendered cloth with normals from the GPU, compact or float vertices" << std::endl <<
     "    * S: save a screenshot" << std::endl <<
+    "    * M: save the shadow map (shadow_map.pgm and .pfm)" << std::endl <<
+    "    * C: start/stop recording the frames (--record-pipe <command> to encode them)" << std::endl <<
     "    * W: toggle wireframe/surface rendering" << std::endl <<
     "    * ESC: quit the program" << std::endl;
 }
@@ -415,8 +747,39 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
     printHelp();
   } else if(action == GLFW_PRESS && key == GLFW_KEY_R) {
     g_scene.resetSim();
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_B) {
+    g_scene.softBodyP = !g_scene.softBodyP;
+    g_scene.resetSim();
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_F) {
+    g_scene.addFluid();
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_J) {
+    g_scene.addProps();
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_T) {
+    g_scene.stiffPatchP = !g_scene.stiffPatchP;
+    g_scene.resetSim();
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_V) {
+    VertexStream &stream = g_scene.clothStream;
+    stream = stream == VertexStream::kPositionsOnly ? VertexStream::kCompact :
+      stream == VertexStream::kCompact ? VertexStream::kFloat : VertexStream::kPositionsOnly;
+    g_scene.resetSim();
+    std::cout << " > Rendered cloth streamed as " << streamName(stream) << std::endl;
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_L) {
+    g_scene.subdivideClothP = !g_scene.subdivideClothP;
+    g_scene.resetSim();
   } else if(action == GLFW_PRESS && key == GLFW_KEY_S) {
     g_scene.saveScreenShot = true;
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_M) {
+    g_scene.saveShadowMap = true;
+  } else if(action == GLFW_PRESS && key == GLFW_KEY_C) {
+    if(g_scene.capture->recording()) {
+      g_scene.capture->stop();
+      std::cout << " > Recording stopped" << std::endl;
+    } else if(g_recordCommand.empty()) {
+      g_scene.capture->startFiles("c");
+      std::cout << " > Recording to c00000.tga, ..." << std::endl;
+    } else if(g_scene.capture->startPipe(g_recordCommand, g_windowWidth, g_windowHeight)) {
+      std::cout << " > Recording to " << g_recordCommand << std::endl;
+    }
   } else if(action == GLFW_PRESS && key == GLFW_KEY_P) {
     g_appTimerStoppedP = !g_appTimerStoppedP;
   } else if(action == GLFW_PRESS && key == GLFW_KEY_W) {
@@ -523,11 +886,27 @@ void clear()
 {
   g_cam.reset();
   g_scene.cloth.reset();
+  g_scene.clothRender.reset();
+  g_scene.clothNormals.clear();
+  g_scene.body.reset();
+  g_scene.fluid.reset();
+  g_scene.fluidPoints.reset();
+  g_scene.props.reset();
+  g_scene.propCube.reset();
   g_scene.plane.reset();
   g_scene.mainShader.reset();
   g_scene.shadomMapShader.reset();
-  glfwDestroyWindow(g_window);
-  glfwTerminate();
+  g_scene.capture.reset();      // after the frames in flight
+  g_scene.cameraUbo.reset();
+  g_scene.lightUbo.reset();
+  g_scene.materialUbo.reset();
+#ifdef SUPPORT_HEADLESS
+  g_headless.destroy();
+#endif
+  if(g_window) {
+    glfwDestroyWindow(g_window);
+    glfwTerminate();
+  }
 }
 
 void exitOnCriticalError(const std::string &message)
@@ -539,11 +918,13 @@ void exitOnCriticalError(const std::string &message)
   std::exit(EXIT_FAILURE);
 }
 
-void initOpenGL()
+void initOpenGL(GLADloadproc loader)
 {
   // Load extensions for modern OpenGL
-  if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+  if(!gladLoadGLLoader(loader))
     exitOnCriticalError("[Failed to initialize OpenGL context]");
+  ShaderProgram::loadBinaryFunctions(loader); // shaders cached after the first launch
+  ShaderProgram::setBinaryCacheDirectory(g_cacheDirectory);
 
 #ifdef SUPPORT_OPENGL_45
   // supported from OpenGL 4.3
@@ -571,13 +952,24 @@ void initOpenGL()
   } catch(std::exception &e) {
     exitOnCriticalError(std::string("[Error loading shader program]") + e.what());
   }
+  try {
+#ifdef SUPPORT_OPENGL_45
+    g_scene.clothNormals.loadProgram("src/computeShaderNormals.glsl");
+#else
+    g_scene.clothNormals.loadProgram("src/vertexShaderNormals.glsl");
+#endif
+  } catch(std::exception &e) {
+    exitOnCriticalError(std::string("[Error loading shader program]") + e.what());
+  }
+  g_scene.initUniforms();
 }
 
 void initScene()
 {
   // Init camera
-  int width, height;
-  glfwGetWindowSize(g_window, &width, &height);
+  int width = g_windowWidth, height = g_windowHeight;
+  if(g_window)
+    glfwGetWindowSize(g_window, &width, &height);
   g_cam = std::make_shared<Camera>();
   g_cam->setAspectRatio(static_cast<float>(width)/static_cast<float>(height));
 
@@ -614,7 +1006,7 @@ void initScene()
   }
 
   // Setup light
-  unsigned int shadow_map_width=2000, shadow_map_height=2000;
+  unsigned int shadow_map_width=kMinShadowMapSize, shadow_map_height=kMinShadowMapSize; // then fit to the view
   g_scene.light.position = glm::vec3(0.0, 1.0, 1.0);
   g_scene.light.color = glm::vec3(1.0, 1.0, 1.0);
   g_scene.light.intensity = 1.0f;
@@ -630,15 +1022,32 @@ void initScene()
   g_cam->setRotation(glm::vec3(-0.2, 0., 0.));
   g_cam->setNear(g_meshScale/100.f);
   g_cam->setFar(6.0*g_meshScale);
+
+  g_scene.capture = std::make_shared<FrameCapture>();
 }
 
 void init()
 {
   initGLFW();                   // Windowing system
-  initOpenGL();                 // OpenGL Context and shader pipeline
+  initOpenGL((GLADloadproc)glfwGetProcAddress); // OpenGL Context and shader pipeline
   initScene();                  // Actual scene to render
 }
 
+#ifdef SUPPORT_HEADLESS
+// Offscreen context and framebuffer instead of the window
+void initHeadless()
+{
+  if(!g_headless.create())
+    std::exit(EXIT_FAILURE);
+  initOpenGL(HeadlessContext::loader());
+  if(!g_headless.allocateFramebuffer(g_windowWidth, g_windowHeight))
+    exitOnCriticalError("[Failed to allocate the offscreen framebuffer]");
+  g_framebuffer = g_headless.framebuffer();
+  std::cout << " > Headless: " << glGetString(GL_RENDERER) << ", " << g_windowWidth << "x" << g_windowHeight << std::endl;
+  initScene();
+}
+#endif
+
 // The main rendering call
 void render()
 {
@@ -653,15 +1062,106 @@ void update(const float currentTime)
 
   if(!g_appTimerStoppedP) {
     g_scene.solver.step(std::min(dt, 0.017f)); // solve for the next step; avoid any chances of too large time step
-    g_scene.solver.updateMesh(*(g_scene.cloth));
+    g_scene.updateMeshes();
   }
 
   g_appTimerLastClockTime = currentTime;
   g_appTimer += dt;
 }
 
+#ifdef SUPPORT_HEADLESS
+// Simulates and renders g_headlessFrames frames at fixed steps of 1/60 s,
+// each written as h00000.tga, ... or piped to g_recordCommand
+void runHeadless()
+{
+  initHeadless();
+  if(g_recordCommand.empty())
+    g_scene.capture->startFiles("h");
+  else if(!g_scene.capture->startPipe(g_recordCommand, g_windowWidth, g_windowHeight))
+    exitOnCriticalError("[Failed to start the encoder]");
+  g_appTimerStoppedP = false;
+  for(int frame = 0; frame < g_headlessFrames; ++frame) {
+    update((frame + 1)/60.f);
+    render();
+  }
+  g_scene.capture->stop();
+}
+#endif
+
+void printUsage()
+{
+  std::cerr
+    << "Usage: xpbd [options]\n"
+    << "  --projective                     cloth solved by projective dynamics\n"
+    << "  --linearized                     cloth solved by linearized XPBD\n"
+    << "  --stiff-patch                    hanging end of the cloth stiffened by shape matching (T)\n"
+    << "  --cloth-stream <format>          rendered cloth streamed as gpu-normals, compact or float (V)\n"
+    << "  --record-pipe <command>          frames recorded with C piped to command, {size} being WxH\n"
+    << "  --headless <width>x<height> <n>  n frames rendered offscreen, without window\n"
+    << "  --cache-dir <dir>                program binaries and rest states kept in dir (cache; \"\": none)\n";
+}
+
+// Reads the command line into the globals; false on an unknown option or a
+// missing value
+bool parseOptions(int argc, char **argv, PbdBackend &backend)
+{
+  for(int a = 1; a < argc; ++a) {
+    const std::string arg = argv[a];
+    const bool hasValue = a + 1 < argc;
+    if(arg == "--projective")
+      backend = PbdBackend::kProjective;
+    else if(arg == "--linearized")
+      backend = PbdBackend::kLinearized;
+    else if(arg == "--stiff-patch")
+      g_scene.stiffPatchP = true;
+    else if(arg == "--cloth-stream" && hasValue && streamFromName(argv[a + 1], g_scene.clothStream))
+      ++a;
+    else if(arg == "--record-pipe" && hasValue)
+      g_recordCommand = argv[++a]; // e.g. "ffmpeg -y -f rawvideo -pixel_format bgr24 -video_size {size} -i - -vf vflip out.mp4"
+    else if(arg == "--cache-dir" && hasValue)
+      g_cacheDirectory = argv[++a];
+    else if(arg == "--headless") { // e.g. --headless 1280x720 600
+      if(a + 2 >= argc ||
+         std::sscanf(argv[a + 1], "%dx%d", &g_windowWidth, &g_windowHeight) != 2 ||
+         g_windowWidth <= 0 || g_windowHeight <= 0 ||
+         (g_headlessFrames = std::atoi(argv[a + 2])) <= 0) {
+        std::cerr << "[xpbd] Error: --headless takes <width>x<height> <frames>" << std::endl;
+        return false;
+      }
+      a += 2;
+    } else {
+      std::cerr << "[xpbd] Error: unknown option or missing value: " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
 int main(int argc, char **argv)
 {
+  PbdBackend backend = PbdBackend::kXpbd;
+  if(!parseOptions(argc, argv, backend)) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+  if(backend == PbdBackend::kProjective)
+    std::cout << " > Cloth solved by projective dynamics" << std::endl;
+  else if(backend == PbdBackend::kLinearized)
+    std::cout << " > Cloth solved by linearized XPBD" << std::endl;
+  if(backend != PbdBackend::kXpbd)
+    g_scene.solver = PbdSolver(20, 1e-9, 10, 0.0f, glm::vec3(0.f, -9.8f, 0.f), backend);
+  g_scene.solver.setCacheDirectory(g_cacheDirectory);
+  if(g_headlessFrames > 0) {
+#ifdef SUPPORT_HEADLESS
+    runHeadless();
+    clear();
+    std::cout << " > Quit" << std::endl;
+    return EXIT_SUCCESS;
+#else
+    std::cerr << "Built without EGL: no headless mode" << std::endl;
+    return EXIT_FAILURE;
+#endif
+  }
   init();
   while(!glfwWindowShouldClose(g_window)) {
     update(static_cast<float>(glfwGetTime()));
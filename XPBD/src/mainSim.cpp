@@ -0,0 +1,203 @@
+// ----------------------------------------------------------------------------
+// mainSim.cpp
+//
+// Description: xpbd_sim, the solver without window nor OpenGL: runs a number
+//              of steps of a scene and writes the simulated surface to disk,
+//              for batches of simulations on machines without a display
+// ----------------------------------------------------------------------------
+
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <exception>
+#include <ios>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MeshData.h"
+#include "TetMesh.h"
+
+#include "PbdSolver.hpp"
+#include "Scenes.hpp"
+
+namespace {
+
+void printUsage()
+{
+  std::cerr
+    << "Usage: xpbd_sim [options]\n"
+    << "  --steps <n>          steps to run (600)\n"
+    << "  --dt <seconds>       time step (1/60)\n"
+    << "  --every <k>          write every k steps, besides the last one (0: the last one only)\n"
+    << "  --out <prefix>       frames written as <prefix><step>.obj (sim)\n"
+    << "  --mesh <file>        cloth loaded from an .obj, .ply or .off file instead of the default one\n"
+    << "  --soft-body          soft body instead of the cloth\n"
+    << "  --tet <basename>     soft body loaded from TetGen's <basename>.node and .ele\n"
+    << "  --fluid              a block of liquid, written as <prefix><step>_fluid.obj\n"
+    << "  --props              rigid bodies holding the default cloth\n"
+    << "  --stiff-patch        hanging end of the default cloth stiffened by shape matching\n"
+    << "  --projective         cloth solved by projective dynamics\n"
+    << "  --linearized         cloth solved by linearized XPBD\n"
+    << "  --cache-dir <dir>    rest states of the cloth kept between runs\n";
+}
+
+struct Options {
+  int steps = 600;
+  float dt = 1.f/60.f;
+  int every = 0;
+  std::string out = "sim";
+  std::string meshFile, tetBasename;
+  bool softBodyP = false, fluidP = false, propsP = false, stiffPatchP = false;
+  PbdBackend backend = PbdBackend::kXpbd;
+  std::string cacheDir;
+};
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+  for(int a = 1; a < argc; ++a) {
+    const std::string arg = argv[a];
+    const bool hasValue = a + 1 < argc;
+    if(arg == "--steps" && hasValue)
+      options.steps = std::atoi(argv[++a]);
+    else if(arg == "--dt" && hasValue)
+      options.dt = std::atof(argv[++a]);
+    else if(arg == "--every" && hasValue)
+      options.every = std::atoi(argv[++a]);
+    else if(arg == "--out" && hasValue)
+      options.out = argv[++a];
+    else if(arg == "--mesh" && hasValue)
+      options.meshFile = argv[++a];
+    else if(arg == "--tet" && hasValue) {
+      options.tetBasename = argv[++a];
+      options.softBodyP = true;
+    } else if(arg == "--soft-body")
+      options.softBodyP = true;
+    else if(arg == "--fluid")
+      options.fluidP = true;
+    else if(arg == "--props")
+      options.propsP = true;
+    else if(arg == "--stiff-patch")
+      options.stiffPatchP = true;
+    else if(arg == "--projective")
+      options.backend = PbdBackend::kProjective;
+    else if(arg == "--linearized")
+      options.backend = PbdBackend::kLinearized;
+    else if(arg == "--cache-dir" && hasValue)
+      options.cacheDir = argv[++a];
+    else {
+      std::cerr << "[xpbd_sim] Error: unknown option or missing value: " << arg << std::endl;
+      return false;
+    }
+  }
+  if(options.steps <= 0 || !(options.dt > 0.f) || options.every < 0) {
+    std::cerr << "[xpbd_sim] Error: --steps and --dt must be positive, --every not negative" << std::endl;
+    return false;
+  }
+  if((options.propsP || options.stiffPatchP) && (options.softBodyP || !options.meshFile.empty())) {
+    std::cerr << "[xpbd_sim] Error: --props and --stiff-patch are for the default cloth only" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// The simulated surface, and the fluid particles when there are some, of the
+// given step
+bool saveFrame(const Options &options, const int step, const MeshData &surface, const PbfFluid *fluid)
+{
+  char number[16];
+  std::snprintf(number, sizeof(number), "%05d", step);
+  const std::string prefix = options.out + number;
+  if(!saveOBJ(prefix + ".obj", surface)) {
+    std::cerr << "[xpbd_sim] Error: cannot write " << prefix << ".obj" << std::endl;
+    return false;
+  }
+  if(fluid) {
+    MeshData points;
+    points.vertexPositions() = fluid->positions();
+    if(!saveOBJ(prefix + "_fluid.obj", points)) {
+      std::cerr << "[xpbd_sim] Error: cannot write " << prefix << "_fluid.obj" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  Options options;
+  if(!parseOptions(argc, argv, options)) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  PbdSolver solver(20, 1e-9, 10, 0.0f, glm::vec3(0.f, -9.8f, 0.f), options.backend);
+  if(!options.cacheDir.empty())
+    solver.setCacheDirectory(options.cacheDir);
+
+  std::shared_ptr<MeshData> surface = std::make_shared<MeshData>();
+  std::shared_ptr<TetMesh> body;
+  std::shared_ptr<PbfFluid> fluid;
+  try {
+    if(options.softBodyP) {
+      body = std::make_shared<TetMesh>();
+      if(options.tetBasename.empty())
+        addSceneSoftBody(*body);
+      else
+        loadTetGen(options.tetBasename, body);
+      body->extractSurface(*surface);
+      solver.initSim(*body);
+    } else if(!options.meshFile.empty()) {
+      const std::string &file = options.meshFile;
+      const std::string extension = file.size() >= 4 ? file.substr(file.size() - 4) : std::string();
+      std::vector<unsigned int> weld;
+      if(extension == ".obj")
+        loadOBJ(file, surface, &weld);
+      else if(extension == ".ply")
+        loadPLY(file, surface, &weld);
+      else if(extension == ".off")
+        loadOFF(file, surface);
+      else
+        throw std::ios_base::failure("[xpbd_sim] Not an .obj, .ply or .off file: " + file);
+      solver.initSim(*surface, weld);
+    } else {
+      addSceneCloth(*surface);
+      solver.initSim(*surface, std::vector<unsigned int>(), sceneClothPins());
+      if(options.stiffPatchP)
+        solver.addShapeMatching(sceneStiffPatch(surface->vertexPositions()));
+    }
+  } catch(const std::exception &e) {
+    std::cerr << "[xpbd_sim] Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(options.fluidP) {
+    fluid = makeSceneFluid();
+    solver.attachFluid(fluid);
+  }
+  if(options.propsP)
+    solver.attachRigidBodies(makeSceneProps());
+
+  std::cout << "[xpbd_sim] " << surface->vertexPositions().size() << " surface vertices"
+            << (fluid ? ", " + std::to_string(fluid->size()) + " particles" : std::string())
+            << ", " << options.steps << " steps of " << options.dt << " s" << std::endl;
+
+  const auto start = std::chrono::steady_clock::now();
+  double writing = 0.0;         // seconds
+  for(int step = 1; step <= options.steps; ++step) {
+    solver.step(options.dt);
+    if(step == options.steps || (options.every > 0 && step % options.every == 0)) {
+      const auto before = std::chrono::steady_clock::now();
+      solver.updateMesh(*surface);
+      if(!saveFrame(options, step, *surface, fluid.get()))
+        return EXIT_FAILURE;
+      writing += std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    }
+  }
+  const double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "[xpbd_sim] " << (total - writing)*1e3/options.steps << " ms per step, "
+            << writing << " s writing, " << total << " s in all" << std::endl;
+  return EXIT_SUCCESS;
+}
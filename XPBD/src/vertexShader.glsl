@@ -4,7 +4,13 @@ layout(location=0) in vec3 vPosition; // the 1st input attribute is the position
 layout(location=1) in vec3 vNormal;
 layout(location=2) in vec2 vTexCoord;
 
-uniform mat4 modelMat, viewMat, projMat;
+layout(std140) uniform Camera { // updated once per frame
+  mat4 viewMat;
+  mat4 projMat;
+  vec3 camPos;
+};
+
+uniform mat4 modelMat;
 uniform mat3 normMat;
 
 out vec3 fPositionModel;
@@ -0,0 +1,28 @@
+#version 330 core            // minimal GL version support expected from the GPU
+
+// Normal of vertex gl_VertexID, captured by transform feedback; nothing is drawn
+
+uniform samplerBuffer positions; // x, y, z of every vertex, as R32F
+uniform usamplerBuffer adjacency; // range of vertex i: [adjacency[i], adjacency[i+1]), pairs (j, k) of its triangles (i, j, k)
+uniform int base;                // first float of the streamed positions
+
+out vec3 normal;
+
+vec3 position(int i) {
+  int k = base + 3*i;
+  return vec3(texelFetch(positions, k).r, texelFetch(positions, k + 1).r, texelFetch(positions, k + 2).r);
+}
+
+void main() {
+  int i = gl_VertexID;
+  vec3 x = position(i);
+  vec3 n = vec3(0.0);
+  int end = int(texelFetch(adjacency, i + 1).r);
+  for(int k = int(texelFetch(adjacency, i).r); k < end; k += 2) {
+    vec3 e1 = position(int(texelFetch(adjacency, k).r)) - x;
+    vec3 e2 = position(int(texelFetch(adjacency, k + 1).r)) - x;
+    n += cross(e1, e2);         // twice the area
+  }
+  float len = length(n);
+  normal = len > 0.0 ? n/len : n;
+}